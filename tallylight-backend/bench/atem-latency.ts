@@ -0,0 +1,53 @@
+// Time from a cut on the mock ATEM until AtemClient has applied the new tally, with optional packet loss to see
+// what retransmits cost.
+//
+//   yarn bench:atem [--inputs 20] [--iterations 500] [--drop 0]
+import {parseArgs} from 'util';
+import {AtemClient} from '../src/atem.js';
+import {startMockAtem} from './atem-mock.js';
+
+const {values: args} = parseArgs({
+    options: {
+        inputs: {type: 'string', default: '20'},
+        iterations: {type: 'string', default: '500'},
+        drop: {type: 'string', default: '0'},
+    },
+});
+
+const inputs = parseInt(args.inputs, 10);
+const iterations = parseInt(args.iterations, 10);
+const sleep = (ms: number) => new Promise(resolve => setTimeout(resolve, ms));
+
+const mock = await startMockAtem(0, inputs, parseFloat(args.drop));
+let changed: (() => void) | null = null;
+const client = new AtemClient(() => changed?.());
+client.start(`127.0.0.1:${mock.port}`);
+
+for (let attempt = 0; !client.connected; attempt++) {
+    if (attempt > 100) throw new Error('no connection to the mock ATEM');
+    await sleep(50);
+}
+
+const samples: number[] = [];
+for (let i = 0; i < iterations; i++) {
+    const input = (mock.program % inputs) + 1;
+    const applied = new Promise<number>((resolve, reject) => {
+        changed = () => {
+            if (client.programInput === input) resolve(performance.now());
+        };
+        setTimeout(() => reject(new Error(`cut ${i} not applied within 5 s`)), 5000);
+    });
+    const start = performance.now();
+    mock.cut(input);
+    samples.push(await applied - start);
+}
+
+samples.sort((a, b) => a - b);
+const percentile = (p: number) => samples[Math.min(samples.length - 1, Math.floor(p * samples.length))]!.toFixed(3);
+console.log(`cut -> tally applied, ${inputs} inputs, ${samples.length} samples, ${(parseFloat(args.drop) * 100).toFixed(0)} % loss`);
+console.log(`  p50 ${percentile(0.5)} ms  p95 ${percentile(0.95)} ms  max ${samples[samples.length - 1]!.toFixed(3)} ms`);
+console.log('client:', client.stats);
+console.log('mock:', mock.stats);
+
+client.stop();
+await mock.close();
@@ -0,0 +1,221 @@
+// Mock ATEM switcher: the session handshake, reliable packets with retransmits, pings, and the commands the
+// backend reads (InPr, PrgI, PrvI, TlIn, InCm). Like a real switcher it sends InPr for black and the internal
+// sources too, which must not show up as inputs. --drop loses that share of the outgoing reliable packets, so the
+// retransmit paths get exercised.
+//
+// Standalone it cuts through the inputs, for pointing a backend's atemAddress at it:
+//   yarn mock:atem [--port 9910] [--inputs 8] [--interval 1000] [--drop 0]
+import dgram from 'dgram';
+import type {AddressInfo} from 'net';
+import {pathToFileURL} from 'url';
+import {parseArgs} from 'util';
+import {
+    atemFlagAck,
+    atemFlagAckRequest,
+    atemFlagHello,
+    atemFlagRetransmit,
+    atemFlagRetransmitRequest,
+    atemHeaderLength,
+    atemHelloAccepted,
+    atemHelloLength,
+    atemPacketIdMask,
+    writeAtemHeader,
+} from '../src/atem.js';
+
+export interface MockAtem {
+    port: number;
+    program: number;
+    preview: number;
+    stats: { sent: number; dropped: number; retransmitted: number };
+    cut(input?: number): void; // input to program, the old program to preview; without input a plain cut
+    setPreview(input: number): void;
+    close(): Promise<void>;
+}
+
+interface Session {
+    address: string;
+    port: number;
+    id: number;
+    nextPacketId: number;
+    unacked: Map<number, { packet: Buffer; sentAt: number }>;
+}
+
+// black, bars, colors, media players and the ME 1 outputs, by source id
+const internalSources: [number, string][] = [
+    [0, 'Black'],
+    [1000, 'Color Bars'],
+    [2001, 'Color 1'],
+    [2002, 'Color 2'],
+    [3010, 'Media Player 1'],
+    [3020, 'Media Player 2'],
+    [10010, 'Program'],
+    [10011, 'Preview'],
+];
+
+const command = (name: string, data: Buffer) => {
+    const buf = Buffer.alloc(8 + data.length);
+    buf.writeUInt16BE(buf.length, 0);
+    buf.write(name, 4, 'ascii');
+    data.copy(buf, 8);
+    return buf;
+};
+
+export const startMockAtem = async (port: number, inputs: number, drop = 0): Promise<MockAtem> => {
+    const socket = dgram.createSocket('udp4');
+    const sessions = new Map<string, Session>();
+    let nextSessionId = 0x8001;
+
+    const inputCommand = (name: string, input: number) => {
+        const data = Buffer.alloc(4);
+        data.writeUInt16BE(input, 2); // ME 1
+        return command(name, data);
+    };
+
+    const tallyCommand = () => {
+        const data = Buffer.alloc(2 + inputs);
+        data.writeUInt16BE(inputs, 0);
+        for (let i = 0; i < inputs; i++) {
+            data[2 + i] = (i + 1 === mock.program ? 0x01 : 0) | (i + 1 === mock.preview ? 0x02 : 0);
+        }
+        return command('TlIn', data);
+    };
+
+    const propertiesCommand = (input: number, name = `Camera ${input}`) => {
+        const data = Buffer.alloc(36);
+        data.writeUInt16BE(input, 0);
+        data.write(name, 2, 'utf8');
+        data.write(`CAM${input}`.slice(0, 4), 22, 'ascii');
+        return command('InPr', data);
+    };
+
+    const transmit = (session: Session, packet: Buffer) => {
+        if (Math.random() < drop) {
+            mock.stats.dropped++;
+            return;
+        }
+        mock.stats.sent++;
+        socket.send(packet, session.port, session.address);
+    };
+
+    const sendReliable = (session: Session, commands: Buffer[]) => {
+        const packet = Buffer.alloc(atemHeaderLength + commands.reduce((sum, c) => sum + c.length, 0));
+        const packetId = session.nextPacketId;
+        session.nextPacketId = (session.nextPacketId + 1) & atemPacketIdMask;
+        writeAtemHeader(packet, atemFlagAckRequest, session.id, 0, packetId);
+        Buffer.concat(commands).copy(packet, atemHeaderLength);
+        session.unacked.set(packetId, {packet, sentAt: Date.now()});
+        transmit(session, packet);
+    };
+
+    const retransmit = (session: Session, packetId: number) => {
+        const entry = session.unacked.get(packetId);
+        if (!entry) return;
+        entry.packet[0] = entry.packet[0]! | atemFlagRetransmit << 3;
+        entry.sentAt = Date.now();
+        mock.stats.retransmitted++;
+        transmit(session, entry.packet);
+    };
+
+    const publish = () => {
+        for (const session of sessions.values()) {
+            sendReliable(session, [inputCommand('PrgI', mock.program), inputCommand('PrvI', mock.preview), tallyCommand()]);
+        }
+    };
+
+    socket.on('message', (msg, remote) => {
+        if (msg.length < atemHeaderLength) return;
+        const flags = msg[0]! >> 3;
+        const key = `${remote.address}:${remote.port}`;
+
+        if (flags & atemFlagHello) {
+            const reply = Buffer.alloc(atemHelloLength);
+            writeAtemHeader(reply, atemFlagHello, msg.readUInt16BE(2), 0, 0);
+            reply[atemHeaderLength] = atemHelloAccepted;
+            socket.send(reply, remote.port, remote.address);
+            sessions.delete(key);
+            return;
+        }
+
+        let session = sessions.get(key);
+        if (!session && flags & atemFlagAck) {
+            // the ack of our hello reply opens the session, the state dump follows
+            session = {address: remote.address, port: remote.port, id: nextSessionId++ & 0xffff, nextPacketId: 1, unacked: new Map()};
+            sessions.set(key, session);
+            const properties = [
+                ...Array.from({length: inputs}, (_, i) => propertiesCommand(i + 1)),
+                ...internalSources.map(([input, name]) => propertiesCommand(input, name)),
+            ];
+            // packets are at most 2047 bytes, the length field has 11 bits
+            for (let i = 0; i < properties.length; i += 32) {
+                sendReliable(session, properties.slice(i, i + 32));
+            }
+            sendReliable(session, [inputCommand('PrgI', mock.program), inputCommand('PrvI', mock.preview), tallyCommand()]);
+            sendReliable(session, [command('InCm', Buffer.alloc(4))]);
+            return;
+        }
+        if (!session) return;
+
+        if (flags & atemFlagAck) {
+            session.unacked.delete(msg.readUInt16BE(4));
+        }
+        if (flags & atemFlagRetransmitRequest) {
+            const from = msg.readUInt16BE(6);
+            for (let id = from; id !== session.nextPacketId; id = (id + 1) & atemPacketIdMask) {
+                retransmit(session, id);
+            }
+        }
+    });
+
+    // pings and resends of what was not acked in time
+    const timer = setInterval(() => {
+        const now = Date.now();
+        for (const session of sessions.values()) {
+            for (const [id, entry] of session.unacked) {
+                if (now - entry.sentAt > 100) retransmit(session, id);
+            }
+            if (session.unacked.size === 0 && now % 500 < 50) sendReliable(session, []);
+        }
+    }, 50);
+
+    await new Promise<void>(resolve => socket.bind(port, resolve));
+
+    const mock: MockAtem = {
+        port: (socket.address() as AddressInfo).port,
+        program: 1,
+        preview: Math.min(2, inputs),
+        stats: {sent: 0, dropped: 0, retransmitted: 0},
+        cut(input) {
+            const previous = mock.program;
+            mock.program = input ?? mock.preview;
+            mock.preview = previous;
+            publish();
+        },
+        setPreview(input) {
+            mock.preview = input;
+            publish();
+        },
+        close: () => new Promise<void>(resolve => {
+            clearInterval(timer);
+            socket.close(() => resolve());
+        }),
+    };
+    return mock;
+};
+
+if (import.meta.url === pathToFileURL(process.argv[1]!).href) {
+    const {values: args} = parseArgs({
+        options: {
+            port: {type: 'string', default: '9910'},
+            inputs: {type: 'string', default: '8'},
+            interval: {type: 'string', default: '1000'},
+            drop: {type: 'string', default: '0'},
+        },
+    });
+
+    const inputs = parseInt(args.inputs, 10);
+    const mock = await startMockAtem(parseInt(args.port, 10), inputs, parseFloat(args.drop));
+    console.log(`mock ATEM with ${inputs} inputs on port ${mock.port}, cutting every ${args.interval} ms`);
+    setInterval(() => {
+        mock.cut(mock.program % inputs + 1);
+    }, parseInt(args.interval, 10));
+}
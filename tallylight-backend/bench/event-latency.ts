@@ -0,0 +1,119 @@
+// Measures the time from an OBS scene change until a light receives its new state.
+//
+// Runs a fake tally light (HTTP + mDNS) next to a running backend, maps it to one scene and switches OBS' program
+// scene back and forth. Needs a running backend without mqttUrl set (states are then sent over HTTP) and OBS with
+// at least two scenes and studio mode off.
+//
+//   yarn bench:latency [--backend http://localhost:3000] [--obs ws://localhost:4455] [--password ...] [--iterations 50]
+import http from 'http';
+import {AddressInfo} from 'net';
+import {parseArgs} from 'util';
+import {Bonjour} from 'bonjour-service';
+import {OBSWebSocket} from 'obs-websocket-js';
+
+const {values: args} = parseArgs({
+    options: {
+        backend: {type: 'string', default: 'http://localhost:3000'},
+        obs: {type: 'string', default: 'ws://localhost:4455'},
+        password: {type: 'string', default: ''},
+        iterations: {type: 'string', default: '50'},
+    },
+});
+
+const iterations = parseInt(args.iterations, 10);
+const name = `Tallylight-bench-${process.pid}`;
+const fqdn = `${name}._tallylight._tcp.local`;
+
+let waitingFor: { state: string; resolve: (at: number) => void } | null = null;
+
+const light = http.createServer((req, res) => {
+    const url = new URL(req.url ?? '/', 'http://light');
+    res.setHeader('Content-Type', 'application/json');
+
+    switch (url.pathname) {
+        case '/set': {
+            const at = performance.now();
+            const state = url.searchParams.get('state') ?? 'OFF';
+            if (waitingFor?.state === state) {
+                waitingFor.resolve(at);
+                waitingFor = null;
+            }
+            res.end(JSON.stringify({success: true, tallyState: state, brightness: 255}));
+            return;
+        }
+        case '/':
+            res.end(JSON.stringify({hostname: name, ip: '127.0.0.1', tallyState: 'OFF', gitHash: 'bench', gitDirty: 'clean', brightness: 255, millis: 0, rssi: 0, utcEpoch: 0}));
+            return;
+        case '/ping':
+            res.end(JSON.stringify({success: true}));
+            return;
+        default:
+            res.statusCode = 404;
+            res.end('{}');
+    }
+});
+
+const api = async (path: string, body?: object) => {
+    const response = await fetch(`${args.backend}${path}`, body ? {
+        method: 'POST',
+        headers: {'Content-Type': 'application/json'},
+        body: JSON.stringify(body),
+    } : {});
+    if (!response.ok) throw new Error(`${path}: ${response.status} ${await response.text()}`);
+    return response.json();
+};
+
+const sleep = (ms: number) => new Promise(resolve => setTimeout(resolve, ms));
+
+await new Promise<void>(resolve => light.listen(0, resolve));
+const port = (light.address() as AddressInfo).port;
+
+const bonjour = new Bonjour();
+bonjour.publish({name, type: 'tallylight', port});
+
+const obs = new OBSWebSocket();
+await obs.connect(args.obs, args.password || undefined);
+const {scenes} = await obs.call('GetSceneList');
+if (scenes.length < 2) throw new Error('OBS needs at least two scenes');
+const [sceneA, sceneB] = scenes.map(scene => scene['sceneUuid'] as string);
+
+console.log('waiting for the backend to discover', fqdn);
+for (let attempt = 0; ; attempt++) {
+    const data = await api('/api/data') as { lightsFound: { fqdn: string }[] };
+    if (data.lightsFound.some(found => found.fqdn === fqdn)) break;
+    if (attempt > 60) throw new Error('backend did not discover the bench light');
+    await sleep(1000);
+}
+
+await api(`/api/add/${encodeURIComponent(fqdn)}`);
+await api(`/api/updateScenes/${encodeURIComponent(fqdn)}`, {scenes: [sceneA]});
+await sleep(1000);
+
+const samples: number[] = [];
+for (let i = 0; i < iterations; i++) {
+    const program = i % 2 === 0 ? sceneA! : sceneB!;
+    const state = program === sceneA ? 'PROGRAM' : 'STANDBY';
+
+    const received = new Promise<number>((resolve, reject) => {
+        waitingFor = {state, resolve};
+        setTimeout(() => reject(new Error(`no ${state} within 5 s`)), 5000);
+    });
+
+    const start = performance.now();
+    await obs.call('SetCurrentProgramScene', {sceneUuid: program});
+    samples.push(await received - start);
+    await sleep(100);
+}
+
+const backendStats = (await api('/api/data') as { eventToFirstLight?: object }).eventToFirstLight;
+
+await api(`/api/remove/${encodeURIComponent(fqdn)}`);
+await obs.disconnect();
+bonjour.unpublishAll(() => bonjour.destroy());
+light.close();
+
+samples.sort((a, b) => a - b);
+const percentile = (p: number) => samples[Math.min(samples.length - 1, Math.floor(p * samples.length))]!.toFixed(2);
+console.log(`scene change -> light, ${samples.length} samples (includes the SetCurrentProgramScene round trip)`);
+console.log(`  p50 ${percentile(0.5)} ms  p95 ${percentile(0.95)} ms  max ${samples[samples.length - 1]!.toFixed(2)} ms`);
+console.log('backend event -> first light:', backendStats);
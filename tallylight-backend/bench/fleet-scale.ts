@@ -0,0 +1,171 @@
+// Fan-out time and ping overhead of a running backend as the fleet grows.
+//
+// For each fleet size it starts virtual lights (fleet-sim.ts), waits until the backend has discovered them, adds
+// them and maps all of them to one TSL display. It then toggles that display's program tally and measures the time
+// until the first and the last light received the new state. Over an idle period it counts the requests the lights
+// get without any tally change (pings, info fetches) and reads the backend's ping round trip from /metrics; with
+// --backend-pid it also reports the backend's CPU use (Linux only).
+//
+// Needs a running backend without mqttUrl, so states go over HTTP. tslPort is set to --tsl-port for the run if the
+// backend has none.
+//
+//   yarn bench:fleet [--backend http://localhost:3000] [--sizes 10,20,40,80] [--iterations 20] [--idle 20]
+//                    [--latency 5] [--jitter 5] [--loss 0] [--tsl-port 8900] [--backend-pid 1234]
+import dgram from 'dgram';
+import fs from 'fs';
+import {parseArgs} from 'util';
+import {encodeTsl5, tslInstance, tslPreview, tslProgram} from '../src/tsl.js';
+import {type Fleet, startFleet} from './fleet-sim.js';
+
+const {values: args} = parseArgs({
+    options: {
+        backend: {type: 'string', default: 'http://localhost:3000'},
+        sizes: {type: 'string', default: '10,20,40,80'},
+        iterations: {type: 'string', default: '20'},
+        idle: {type: 'string', default: '20'},
+        latency: {type: 'string', default: '5'},
+        jitter: {type: 'string', default: '5'},
+        loss: {type: 'string', default: '0'},
+        'tsl-port': {type: 'string', default: '8900'},
+        'backend-pid': {type: 'string'},
+    },
+});
+
+const iterations = parseInt(args.iterations, 10);
+const idleSeconds = parseFloat(args.idle);
+const display = 1;
+
+const api = async (path: string, body?: object) => {
+    const response = await fetch(`${args.backend}${path}`, body ? {
+        method: 'POST',
+        headers: {'Content-Type': 'application/json'},
+        body: JSON.stringify(body),
+    } : {});
+    if (!response.ok) throw new Error(`${path}: ${response.status} ${await response.text()}`);
+    return response.json();
+};
+
+const sleep = (ms: number) => new Promise(resolve => setTimeout(resolve, ms));
+
+// sum and count of a histogram over all its series
+const histogram = async (name: string) => {
+    const text = await (await fetch(`${args.backend}/metrics`)).text();
+    const total = (suffix: string) => [...text.matchAll(new RegExp(`^${name}_${suffix}(?:\\{[^}]*\\})? (\\S+)$`, 'gm'))]
+        .reduce((sum, match) => sum + parseFloat(match[1]!), 0);
+    return {sum: total('sum'), count: total('count')};
+};
+
+// user + system CPU seconds of a process, from /proc
+const cpuSeconds = (pid: string) => {
+    const fields = fs.readFileSync(`/proc/${pid}/stat`, 'utf-8').split(') ')[1]!.split(' ');
+    return (parseInt(fields[11]!, 10) + parseInt(fields[12]!, 10)) / 100;
+};
+
+const percentile = (samples: number[], p: number) => {
+    const sorted = [...samples].sort((a, b) => a - b);
+    return sorted.length ? sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))]! : NaN;
+};
+
+const config = await api('/api/config') as { tslPort?: number; mqttUrl?: string };
+if (config.mqttUrl) throw new Error('the backend has mqttUrl set, states would not reach the virtual lights');
+const tslPort = config.tslPort || parseInt(args['tsl-port'], 10);
+if (!config.tslPort) await api('/api/config/tslPort', {value: tslPort});
+const tslHost = new URL(args.backend).hostname;
+const tsl = dgram.createSocket('udp4');
+// another display stays on preview, so with nothing on program the lights are STANDBY and not ERROR, also without OBS
+const sendTally = (tally: number) => new Promise<void>(resolve => tsl.send(encodeTsl5(0, [
+    {index: display, tally, label: 'FLEET'},
+    {index: display + 1, tally: tslPreview, label: 'FLEET PVW'},
+]), tslPort, tslHost, () => resolve()));
+
+const run = async (size: number) => {
+    const fleet: Fleet = await startFleet({
+        lights: size,
+        latencyMs: parseFloat(args.latency),
+        jitterMs: parseFloat(args.jitter),
+        loss: parseFloat(args.loss),
+        prefix: `Tallylight-fleet-${process.pid}-${size}`,
+    });
+    const fqdns = new Set(fleet.lights.map(light => light.fqdn));
+
+    try {
+        for (let attempt = 0; ; attempt++) {
+            const data = await api('/api/data') as { lightsFound: { fqdn: string }[] };
+            if (data.lightsFound.filter(found => fqdns.has(found.fqdn)).length === size) break;
+            if (attempt > 60) throw new Error(`backend did not discover all ${size} virtual lights`);
+            await sleep(1000);
+        }
+
+        for (const fqdn of fqdns) {
+            await api(`/api/add/${encodeURIComponent(fqdn)}`);
+            await api(`/api/updateScenes/${encodeURIComponent(fqdn)}`, {scenes: [{instance: tslInstance, sceneUuid: `0:${display}`}]});
+        }
+        await sendTally(0);
+        await sleep(2000);
+
+        // fan-out: every light has to receive the state of each toggle
+        const first: number[] = [];
+        const last: number[] = [];
+        let missed = 0;
+        const updatesBefore = await histogram('tally_update_seconds');
+        for (let i = 0; i < iterations; i++) {
+            const onProgram = i % 2 === 0;
+            const expected = onProgram ? 'PROGRAM' : 'STANDBY';
+            const received = new Map<string, number>();
+            const done = new Promise<void>(resolve => {
+                fleet.onSet = (light, state, at) => {
+                    if (state !== expected || received.has(light.fqdn)) return;
+                    received.set(light.fqdn, at);
+                    if (received.size === size) resolve();
+                };
+                setTimeout(resolve, 5000);
+            });
+
+            const start = performance.now();
+            await sendTally(onProgram ? tslProgram : 0);
+            await done;
+            fleet.onSet = null;
+
+            missed += size - received.size;
+            if (received.size > 0) {
+                first.push(Math.min(...received.values()) - start);
+                last.push(Math.max(...received.values()) - start);
+            }
+            await sleep(200);
+        }
+        const updatesAfter = await histogram('tally_update_seconds');
+
+        // idle: only pings, info fetches and reconciliation
+        const requestsBefore = fleet.totals();
+        const pingsBefore = await histogram('tally_light_ping_seconds');
+        const cpuBefore = args['backend-pid'] ? cpuSeconds(args['backend-pid']) : 0;
+        const idleStart = performance.now();
+        await sleep(idleSeconds * 1000);
+        const idleElapsed = (performance.now() - idleStart) / 1000;
+        const cpu = args['backend-pid'] ? (cpuSeconds(args['backend-pid']) - cpuBefore) / idleElapsed * 100 : NaN;
+        const requestsAfter = fleet.totals();
+        const pingsAfter = await histogram('tally_light_ping_seconds');
+
+        const perSecond = (key: 'ping' | 'info' | 'set') => ((requestsAfter[key] - requestsBefore[key]) / idleElapsed).toFixed(1);
+        const updateMs = (updatesAfter.sum - updatesBefore.sum) / (updatesAfter.count - updatesBefore.count) * 1000;
+        const pingMs = (pingsAfter.sum - pingsBefore.sum) / (pingsAfter.count - pingsBefore.count) * 1000;
+
+        console.log(`${String(size).padStart(4)} lights  ` +
+            `first p50 ${percentile(first, 0.5).toFixed(1)} ms  last p50 ${percentile(last, 0.5).toFixed(1)} p95 ${percentile(last, 0.95).toFixed(1)} ms  ` +
+            `update ${updateMs.toFixed(2)} ms  missed ${missed}  |  idle/s: ${perSecond('ping')} ping ${perSecond('info')} info ${perSecond('set')} set  ` +
+            `ping rtt ${pingMs.toFixed(1)} ms${args['backend-pid'] ? `  backend cpu ${cpu.toFixed(1)} %` : ''}`);
+    } finally {
+        for (const fqdn of fqdns) {
+            await api(`/api/remove/${encodeURIComponent(fqdn)}`).catch(() => undefined);
+        }
+        await fleet.close();
+    }
+};
+
+console.log(`fan-out of ${iterations} TSL toggles per size, ${args.latency} ms latency + ${args.jitter} ms jitter, ${args.loss} loss, ${idleSeconds} s idle`);
+for (const size of args.sizes.split(',').map(size => parseInt(size, 10))) {
+    await run(size);
+}
+
+tsl.close();
+if (!config.tslPort) await api('/api/config/tslPort', {value: 0});
@@ -0,0 +1,262 @@
+// Virtual tally light fleet: N lights that implement the firmware's HTTP API (/, /set, /ping, /identify, /restart)
+// and announce themselves as _tallylight._tcp over mDNS, so a backend can be loaded at event scale without hardware.
+// They answer /capabilities with 404 like firmware from before it, so the backend talks plain HTTP to them.
+//
+//   latency, jitter: added to every response, in ms
+//   loss:            share of requests that are never answered; the backend runs into its timeout, as on bad WiFi
+//   reboot-every:    mean seconds between spontaneous reboots of each light, 0 for never; /restart reboots too
+//   reboot-ms:       how long a reboot takes; meanwhile the light does not answer, then it announces itself again
+//
+//   yarn sim:fleet [--lights 80] [--latency 5] [--jitter 5] [--loss 0] [--reboot-every 0] [--reboot-ms 3000]
+//                  [--api-key ...] [--prefix Tallylight-sim]
+import http from 'http';
+import type {AddressInfo} from 'net';
+import {pathToFileURL} from 'url';
+import {parseArgs} from 'util';
+import {Bonjour, type Service} from 'bonjour-service';
+
+export interface FleetOptions {
+    lights: number;
+    latencyMs?: number;
+    jitterMs?: number;
+    loss?: number;
+    rebootEverySeconds?: number;
+    rebootMs?: number;
+    apiKey?: string; // checked like the firmware does, if set
+    prefix?: string;
+}
+
+export interface LightStats {
+    set: number;
+    ping: number;
+    info: number;
+    identify: number;
+    restart: number;
+    lost: number;
+    reboots: number;
+}
+
+export interface VirtualLight {
+    name: string;
+    fqdn: string;
+    port: number;
+    state: string;
+    brightness: number;
+    online: boolean;
+    stats: LightStats;
+}
+
+export interface Fleet {
+    lights: VirtualLight[];
+    onSet: ((light: VirtualLight, state: string, at: number) => void) | null; // at: performance.now()
+    totals(): LightStats;
+    close(): Promise<void>;
+}
+
+const emptyStats = (): LightStats => ({set: 0, ping: 0, info: 0, identify: 0, restart: 0, lost: 0, reboots: 0});
+
+export const startFleet = async (options: FleetOptions): Promise<Fleet> => {
+    const latencyMs = options.latencyMs ?? 0;
+    const jitterMs = options.jitterMs ?? 0;
+    const loss = options.loss ?? 0;
+    const rebootMs = options.rebootMs ?? 3000;
+    const prefix = options.prefix ?? 'Tallylight-sim';
+
+    // one responder for all lights, like one multicast socket per host
+    const bonjour = new Bonjour();
+    const timers = new Set<NodeJS.Timeout>();
+    const later = (ms: number, callback: () => void) => {
+        const timer = setTimeout(() => {
+            timers.delete(timer);
+            callback();
+        }, ms);
+        timers.add(timer);
+    };
+
+    const fleet: Fleet = {
+        lights: [],
+        onSet: null,
+        totals: () => {
+            const totals = emptyStats();
+            for (const light of fleet.lights) {
+                for (const key of Object.keys(totals) as (keyof LightStats)[]) totals[key] += light.stats[key];
+            }
+            return totals;
+        },
+        close: async () => {
+            timers.forEach(timer => clearTimeout(timer));
+            timers.clear();
+            await Promise.all(servers.map(server => new Promise<void>(resolve => {
+                server.closeAllConnections();
+                // also called if a rebooting light's server is not listening
+                server.close(() => resolve());
+            })));
+            await new Promise<void>(resolve => bonjour.unpublishAll(() => resolve()));
+            bonjour.destroy();
+        },
+    };
+    const servers: http.Server[] = [];
+
+    const startLight = async (n: number) => {
+        const name = `${prefix}-${n}`;
+        let bootedAt = Date.now();
+        let service: Service | null = null;
+
+        const light: VirtualLight = {
+            name,
+            fqdn: `${name}._tallylight._tcp.local`,
+            port: 0,
+            state: 'OFF',
+            brightness: 255,
+            online: true,
+            stats: emptyStats(),
+        };
+
+        const announce = () => {
+            service = bonjour.publish({name, type: 'tallylight', port: light.port});
+        };
+
+        // Stops answering for rebootMs, then comes back with its power-on state. A crashing ESP sends no mDNS
+        // goodbye; the goodbye and new announcement on boot make the backend see it come up again, which is what
+        // it sees from real lights once its cache has expired.
+        const reboot = () => {
+            if (!light.online) return;
+            light.online = false;
+            light.stats.reboots++;
+            server.closeAllConnections();
+            server.close();
+            later(rebootMs, () => {
+                server.listen(light.port, () => {
+                    light.online = true;
+                    light.state = 'OFF';
+                    bootedAt = Date.now();
+                    if (service) service.stop(() => announce()); else announce();
+                });
+            });
+        };
+
+        const scheduleReboot = () => {
+            if (!options.rebootEverySeconds) return;
+            // exponential, so the reboots of the fleet are spread like independent failures
+            later(-Math.log(1 - Math.random()) * options.rebootEverySeconds * 1000, () => {
+                reboot();
+                scheduleReboot();
+            });
+        };
+
+        const server = http.createServer((req, res) => {
+            const url = new URL(req.url ?? '/', 'http://light');
+            if (Math.random() < loss) {
+                // never answered; the backend's abort closes the connection
+                light.stats.lost++;
+                return;
+            }
+
+            const apiKeyValid = !options.apiKey || url.searchParams.get('apiKey') === options.apiKey;
+            const reply = (status: number, body: string, contentType = 'application/json') => {
+                later(latencyMs + Math.random() * jitterMs, () => {
+                    res.writeHead(status, {'Content-Type': contentType});
+                    res.end(body);
+                });
+            };
+            const forbidden = () => reply(403, '{"error":"Invalid API key", "success": false}');
+
+            switch (url.pathname) {
+                case '/set': {
+                    light.stats.set++;
+                    if (!apiKeyValid) return forbidden();
+                    const state = url.searchParams.get('state');
+                    if (state) light.state = state;
+                    const brightness = parseInt(url.searchParams.get('brightness') ?? '', 10);
+                    if (!isNaN(brightness)) light.brightness = brightness;
+                    fleet.onSet?.(light, light.state, performance.now());
+                    return reply(200, JSON.stringify({success: true, tallyState: light.state, brightness: light.brightness}));
+                }
+                case '/ping':
+                    light.stats.ping++;
+                    return reply(200, 'pong', 'text/plain');
+                case '/':
+                    light.stats.info++;
+                    return reply(200, JSON.stringify({
+                        hostname: name,
+                        ip: '127.0.0.1',
+                        tallyState: light.state,
+                        gitHash: 'sim',
+                        gitDirty: 'clean',
+                        brightness: light.brightness,
+                        millis: Date.now() - bootedAt,
+                        rssi: -50 - n % 30,
+                        utcEpoch: Math.floor(Date.now() / 1000),
+                    }));
+                case '/identify':
+                    light.stats.identify++;
+                    if (!apiKeyValid) return forbidden();
+                    return reply(200, '{"success": true}');
+                case '/restart':
+                    light.stats.restart++;
+                    if (!apiKeyValid) return forbidden();
+                    reply(200, '{"success": true, "message": "Resetting..."}');
+                    // the firmware waits a second before it resets
+                    later(latencyMs + jitterMs + 1000, reboot);
+                    return;
+                default:
+                    return reply(404, '{}');
+            }
+        });
+        servers.push(server);
+
+        await new Promise<void>(resolve => server.listen(0, resolve));
+        light.port = (server.address() as AddressInfo).port;
+        announce();
+        scheduleReboot();
+        fleet.lights.push(light);
+    };
+
+    for (let n = 1; n <= options.lights; n++) {
+        await startLight(n);
+    }
+    return fleet;
+};
+
+if (import.meta.url === pathToFileURL(process.argv[1]!).href) {
+    const {values: args} = parseArgs({
+        options: {
+            lights: {type: 'string', default: '80'},
+            latency: {type: 'string', default: '5'},
+            jitter: {type: 'string', default: '5'},
+            loss: {type: 'string', default: '0'},
+            'reboot-every': {type: 'string', default: '0'},
+            'reboot-ms': {type: 'string', default: '3000'},
+            'api-key': {type: 'string'},
+            prefix: {type: 'string', default: 'Tallylight-sim'},
+        },
+    });
+
+    const fleet = await startFleet({
+        lights: parseInt(args.lights, 10),
+        latencyMs: parseFloat(args.latency),
+        jitterMs: parseFloat(args.jitter),
+        loss: parseFloat(args.loss),
+        rebootEverySeconds: parseFloat(args['reboot-every']),
+        rebootMs: parseInt(args['reboot-ms'], 10),
+        apiKey: args['api-key'],
+        prefix: args.prefix,
+    });
+    console.log(`${fleet.lights.length} virtual lights on ports ${fleet.lights[0]?.port}..${fleet.lights.at(-1)?.port}`);
+
+    let last = fleet.totals();
+    setInterval(() => {
+        const totals = fleet.totals();
+        const states = new Map<string, number>();
+        fleet.lights.forEach(light => states.set(light.state, (states.get(light.state) ?? 0) + 1));
+        console.log(`last 5 s: ${totals.set - last.set} set, ${totals.ping - last.ping} ping, ${totals.info - last.info} info, ` +
+            `${totals.lost - last.lost} lost, ${totals.reboots - last.reboots} reboots; ` +
+            `${fleet.lights.filter(light => light.online).length} online, ${[...states].map(([state, count]) => `${count} ${state}`).join(', ')}`);
+        last = totals;
+    }, 5000);
+
+    process.on('SIGINT', async () => {
+        await fleet.close();
+        process.exit(0);
+    });
+}
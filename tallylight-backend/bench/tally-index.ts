@@ -0,0 +1,105 @@
+// Compares computing every light's state with visibleInScenes.includes() (what the backend did before TallyIndex)
+// against the index, for random program/preview changes.
+//
+//   yarn bench:index [--lights 5000] [--scenes 2000] [--scenes-per-light 5] [--changes 2000]
+import {parseArgs} from 'util';
+import {liveScenesOf, type LiveScenes, type ProgramPreview, TallyIndex} from '../src/tally-index.js';
+import type {TallyLightState} from '../src/types.js';
+
+const {values: args} = parseArgs({
+    options: {
+        lights: {type: 'string', default: '5000'},
+        scenes: {type: 'string', default: '2000'},
+        'scenes-per-light': {type: 'string', default: '5'},
+        changes: {type: 'string', default: '2000'},
+    },
+});
+
+const lightCount = parseInt(args.lights, 10);
+const sceneCount = parseInt(args.scenes, 10);
+const scenesPerLight = parseInt(args['scenes-per-light'], 10);
+const changeCount = parseInt(args.changes, 10);
+
+// deterministic (mulberry32), so runs are comparable
+let seed = 42;
+const random = (max: number) => {
+    seed = (seed + 0x6D2B79F5) | 0;
+    let t = Math.imul(seed ^ (seed >>> 15), 1 | seed);
+    t = (t + Math.imul(t ^ (t >>> 7), 61 | t)) ^ t;
+    return ((t ^ (t >>> 14)) >>> 0) % max;
+};
+
+const scenes = Array.from({length: sceneCount}, (_, i) => `scene-${i}`);
+const lights: Record<string, string[]> = {};
+for (let i = 0; i < lightCount; i++) {
+    lights[`light-${i}`] = Array.from({length: scenesPerLight}, () => scenes[random(sceneCount)]!);
+}
+
+const changes: ProgramPreview[] = Array.from({length: changeCount}, () => ({
+    programSceneUuid: scenes[random(sceneCount)]!,
+    previewSceneUuid: scenes[random(sceneCount)]!,
+}));
+
+const naiveState = (visibleInScenes: string[], {programSceneUuid, previewSceneUuid}: ProgramPreview): TallyLightState => {
+    if (!programSceneUuid && !previewSceneUuid) return 'ERROR';
+    if (programSceneUuid && visibleInScenes.includes(programSceneUuid)) return 'PROGRAM';
+    if (previewSceneUuid && visibleInScenes.includes(previewSceneUuid)) return 'PREVIEW';
+    return visibleInScenes.length > 0 ? 'STANDBY' : 'OFF';
+};
+
+const measure = (name: string, run: () => number) => {
+    const start = performance.now();
+    const touched = run();
+    const elapsed = performance.now() - start;
+    console.log(`${name.padEnd(8)} ${(elapsed / changeCount * 1000).toFixed(1).padStart(9)} us/change  ${(touched / changeCount).toFixed(1).padStart(8)} lights/change`);
+    return elapsed;
+};
+
+console.log(`${lightCount} lights, ${sceneCount} scenes, ${scenesPerLight} scenes per light, ${changeCount} changes`);
+
+const naiveStates: Record<string, TallyLightState> = {};
+const naive = measure('naive', () => {
+    let touched = 0;
+    for (const change of changes) {
+        for (const [fqdn, visibleInScenes] of Object.entries(lights)) {
+            naiveStates[fqdn] = naiveState(visibleInScenes, change);
+            touched++;
+        }
+    }
+    return touched;
+});
+
+const buildStart = performance.now();
+const index = new TallyIndex();
+for (const [fqdn, visibleInScenes] of Object.entries(lights)) {
+    index.setLightScenes(fqdn, visibleInScenes);
+}
+console.log(`index built in ${(performance.now() - buildStart).toFixed(1)} ms`);
+
+const indexedStates: Record<string, TallyLightState> = {};
+for (const fqdn of Object.keys(lights)) {
+    indexedStates[fqdn] = index.stateOf(fqdn, liveScenesOf({programSceneUuid: null, previewSceneUuid: null}));
+}
+
+const indexed = measure('indexed', () => {
+    let touched = 0;
+    let previous: LiveScenes = liveScenesOf({programSceneUuid: null, previewSceneUuid: null});
+    for (const change of changes) {
+        const live = liveScenesOf(change);
+        const affected = index.affectedLights(previous, live) ?? Object.keys(lights);
+        for (const fqdn of affected) {
+            indexedStates[fqdn] = index.stateOf(fqdn, live);
+            touched++;
+        }
+        previous = live;
+    }
+    return touched;
+});
+
+// both end at the last change, so they must agree on every light
+const mismatches = Object.keys(lights).filter(fqdn => naiveStates[fqdn] !== indexedStates[fqdn]);
+if (mismatches.length > 0) {
+    console.error(`${mismatches.length} lights differ, e.g. ${mismatches[0]}`);
+    process.exit(1);
+}
+console.log(`speedup ${(naive / indexed).toFixed(1)}x, results identical`);
@@ -0,0 +1,122 @@
+// TSL UMD packet generator and ingest throughput.
+//
+//   parse: feeds generated packets straight into TslReceiver, measures the parser and change tracking alone
+//   udp:   sends generated packets over UDP at --rate packets/s, to --target or to a local receiver (then loss is
+//          reported too); point --target at a backend with tslPort set to load it with switcher traffic
+//
+//   yarn bench:tsl [--mode parse|udp] [--packets 1000000] [--displays 16] [--per-packet 8] [--v31]
+//                  [--rate 10000] [--seconds 5] [--target 127.0.0.1:8900]
+import dgram from 'dgram';
+import {parseArgs} from 'util';
+import {encodeTsl31, encodeTsl5, tslPreview, tslProgram, TslReceiver} from '../src/tsl.js';
+
+const {values: args} = parseArgs({
+    options: {
+        mode: {type: 'string', default: 'parse'},
+        packets: {type: 'string', default: '1000000'},
+        displays: {type: 'string', default: '16'},
+        'per-packet': {type: 'string', default: '8'},
+        v31: {type: 'boolean', default: false},
+        rate: {type: 'string', default: '10000'},
+        seconds: {type: 'string', default: '5'},
+        target: {type: 'string'},
+    },
+});
+
+const displayCount = parseInt(args.displays, 10);
+const perPacket = Math.min(parseInt(args['per-packet'], 10), displayCount);
+
+// A switcher cutting through its inputs: packet n puts display n % displays on program and the next one on
+// preview. Like real switchers, every packet repeats the state of a block of displays, most of them unchanged.
+const generate = (n: number): Buffer => {
+    const program = n % displayCount;
+    const preview = (n + 1) % displayCount;
+    const tallyOf = (index: number) => (index === program ? tslProgram : 0) | (index === preview ? tslPreview : 0);
+
+    if (args.v31) {
+        return encodeTsl31(n % Math.min(displayCount, 127), tallyOf(n % Math.min(displayCount, 127)), `CAM ${n % displayCount + 1}`);
+    }
+    const first = Math.floor(n / displayCount) * perPacket % displayCount;
+    return encodeTsl5(0, Array.from({length: perPacket}, (_, i) => {
+        const index = (first + i) % displayCount;
+        return {index, tally: tallyOf(index), label: `CAM ${index + 1}`};
+    }));
+};
+
+// generated up front and cycled, so the bench measures the receiver and not the generator
+const packets = Array.from({length: displayCount * displayCount}, (_, n) => generate(n));
+console.log(`${packets.length} distinct packets, ${args.v31 ? 'v3.1' : `v5 with ${perPacket} displays each`}, ${displayCount} displays`);
+
+const heapMb = () => process.memoryUsage().heapUsed / 1024 / 1024;
+
+if (args.mode === 'parse') {
+    const count = parseInt(args.packets, 10);
+    let tallyChanges = 0;
+    const receiver = new TslReceiver((_display, tallyChanged) => {
+        if (tallyChanged) tallyChanges++;
+    });
+
+    // warm up, so the displays exist and the JIT has settled
+    for (let i = 0; i < packets.length * 10; i++) receiver.handle(packets[i % packets.length]!);
+
+    const heapBefore = heapMb();
+    const start = performance.now();
+    for (let i = 0; i < count; i++) {
+        receiver.handle(packets[i % packets.length]!);
+    }
+    const elapsed = (performance.now() - start) / 1000;
+
+    console.log(`${(count / elapsed / 1e6).toFixed(2)} M packets/s, ${(receiver.stats.displayMessages / receiver.stats.packets * count / elapsed / 1e6).toFixed(2)} M display messages/s`);
+    console.log(`${tallyChanges} tally changes, ${receiver.stats.invalid} invalid, heap ${heapBefore.toFixed(1)} -> ${heapMb().toFixed(1)} MB`);
+} else if (args.mode === 'udp') {
+    const rate = parseInt(args.rate, 10);
+    const seconds = parseFloat(args.seconds);
+
+    let receiver: TslReceiver | null = null;
+    let target: { host: string; port: number };
+    if (args.target) {
+        const [host, port] = args.target.split(':');
+        target = {host: host!, port: parseInt(port!, 10)};
+    } else {
+        receiver = new TslReceiver(() => undefined);
+        receiver.start(0);
+        await new Promise(resolve => setTimeout(resolve, 100));
+        target = {host: '127.0.0.1', port: receiver.port!};
+    }
+
+    const socket = dgram.createSocket('udp4');
+    let sent = 0;
+    const start = performance.now();
+    const end = start + seconds * 1000;
+
+    // sends in 1 ms slices to approximate the rate without a timer per packet
+    await new Promise<void>(resolve => {
+        const tick = () => {
+            const now = performance.now();
+            if (now >= end) {
+                resolve();
+                return;
+            }
+            const due = Math.floor((now - start) / 1000 * rate);
+            while (sent < due) {
+                socket.send(packets[sent % packets.length]!, target.port, target.host);
+                sent++;
+            }
+            setImmediate(tick);
+        };
+        tick();
+    });
+    const elapsed = (performance.now() - start) / 1000;
+    await new Promise(resolve => setTimeout(resolve, 200));
+
+    console.log(`sent ${sent} packets in ${elapsed.toFixed(2)} s, ${(sent / elapsed).toFixed(0)} packets/s to ${target.host}:${target.port}`);
+    if (receiver) {
+        const received = receiver.stats.packets;
+        console.log(`received ${received} (${((1 - received / sent) * 100).toFixed(2)} % lost), ${receiver.stats.changes} changes, ${receiver.stats.invalid} invalid`);
+        receiver.stop();
+    }
+    socket.close();
+} else {
+    console.error('unknown --mode', args.mode);
+    process.exit(1);
+}
@@ -0,0 +1,60 @@
+// Time from a cut on a (mock) vMix until VmixClient has applied the new tally, and how fast the client parses
+// tally lines.
+//
+//   yarn bench:vmix [--inputs 100] [--iterations 1000] [--lines 1000000]
+import {parseArgs} from 'util';
+import {VmixClient} from '../src/vmix.js';
+import {startMockVmix} from './vmix-mock.js';
+
+const {values: args} = parseArgs({
+    options: {
+        inputs: {type: 'string', default: '100'},
+        iterations: {type: 'string', default: '1000'},
+        lines: {type: 'string', default: '1000000'},
+    },
+});
+
+const inputs = parseInt(args.inputs, 10);
+const iterations = parseInt(args.iterations, 10);
+
+const mock = await startMockVmix(0, inputs);
+
+let changed: (() => void) | null = null;
+const client = new VmixClient(() => changed?.());
+const connected = new Promise<void>(resolve => {
+    changed = resolve;
+});
+client.start(`127.0.0.1:${mock.port}`);
+await connected;
+
+const samples: number[] = [];
+for (let i = 0; i < iterations; i++) {
+    const applied = new Promise<number>(resolve => {
+        changed = () => resolve(performance.now());
+    });
+    const start = performance.now();
+    mock.cut(i % inputs + 1);
+    samples.push(await applied - start);
+}
+
+samples.sort((a, b) => a - b);
+const percentile = (p: number) => samples[Math.min(samples.length - 1, Math.floor(p * samples.length))]!.toFixed(3);
+console.log(`cut -> tally applied over TCP, ${inputs} inputs, ${samples.length} samples`);
+console.log(`  p50 ${percentile(0.5)} ms  p95 ${percentile(0.95)} ms  max ${samples[samples.length - 1]!.toFixed(3)} ms`);
+
+client.stop();
+await mock.close();
+
+// parser alone: alternating lines so every line changes two inputs, split at odd places like TCP may do
+const lineCount = parseInt(args.lines, 10);
+const lines = [0, 1].map(n => Buffer.from(`TALLY OK ${Array.from({length: inputs}, (_, i) => i === n ? '1' : i === 1 - n ? '2' : '0').join('')}\r\n`, 'latin1'));
+const chunks = lines.flatMap(line => [line.subarray(0, 7), line.subarray(7)]);
+let changes = 0;
+const parser = new VmixClient(() => changes++);
+const heapBefore = process.memoryUsage().heapUsed;
+const start = performance.now();
+for (let i = 0; i < lineCount * 2; i++) {
+    parser.feed(chunks[i % chunks.length]!);
+}
+const elapsed = (performance.now() - start) / 1000;
+console.log(`parser: ${(lineCount / elapsed / 1e6).toFixed(2)} M tally lines/s (split in two chunks each), ${changes} changes, heap +${((process.memoryUsage().heapUsed - heapBefore) / 1024 / 1024).toFixed(1)} MB`);
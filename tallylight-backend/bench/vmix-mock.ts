@@ -0,0 +1,111 @@
+// Mock vMix TCP API: the subset the backend uses (SUBSCRIBE TALLY, TALLY, XML) plus FUNCTION Cut/PreviewInput, so
+// tests and benchmarks can drive tally changes without vMix.
+//
+// Standalone it cuts through the inputs, for pointing a backend's vmixAddress at it:
+//   yarn mock:vmix [--port 8099] [--inputs 8] [--interval 1000]
+import net from 'net';
+import type {AddressInfo} from 'net';
+import {pathToFileURL} from 'url';
+import {parseArgs} from 'util';
+
+export interface MockVmix {
+    port: number;
+    program: number;
+    preview: number;
+    cut(input?: number): void; // input to program, the old program to preview; without input a plain cut
+    setPreview(input: number): void;
+    close(): Promise<void>;
+}
+
+export const startMockVmix = async (port: number, inputs: number): Promise<MockVmix> => {
+    const subscribers = new Set<net.Socket>();
+
+    const tallyLine = () => {
+        let tally = '';
+        for (let input = 1; input <= inputs; input++) {
+            tally += input === mock.program ? '1' : input === mock.preview ? '2' : '0';
+        }
+        return `TALLY OK ${tally}\r\n`;
+    };
+
+    const xml = () => {
+        const inputList = Array.from({length: inputs}, (_, i) =>
+            `<input key="mock-${i + 1}" number="${i + 1}" type="Capture" title="Camera ${i + 1}" state="Running">Camera ${i + 1}</input>`).join('');
+        return `<vmix><version>27.0.0.0</version><inputs>${inputList}</inputs><active>${mock.program}</active><preview>${mock.preview}</preview></vmix>`;
+    };
+
+    const publish = () => {
+        const line = tallyLine();
+        for (const socket of subscribers) socket.write(line);
+    };
+
+    const server = net.createServer((socket) => {
+        socket.setNoDelay(true);
+        let rest = '';
+        socket.on('data', (chunk) => {
+            const lines = (rest + chunk.toString('latin1')).split('\r\n');
+            rest = lines.pop()!;
+            for (const line of lines) {
+                const [command, ...args] = line.split(' ');
+                if (command === 'SUBSCRIBE' && args[0] === 'TALLY') {
+                    subscribers.add(socket);
+                    socket.write('SUBSCRIBE OK TALLY\r\n');
+                } else if (command === 'TALLY') {
+                    socket.write(tallyLine());
+                } else if (command === 'XML') {
+                    const body = xml();
+                    socket.write(`XML ${Buffer.byteLength(body)}\r\n${body}`);
+                } else if (command === 'FUNCTION') {
+                    const input = parseInt(/Input=(\d+)/.exec(args.join(' '))?.[1] ?? '', 10);
+                    if (args[0] === 'Cut') mock.cut(isNaN(input) ? undefined : input);
+                    if (args[0] === 'PreviewInput' && !isNaN(input)) mock.setPreview(input);
+                    socket.write(`FUNCTION OK Completed\r\n`);
+                } else {
+                    socket.write(`${command} ER Unknown command\r\n`);
+                }
+            }
+        });
+        socket.on('close', () => subscribers.delete(socket));
+        socket.on('error', () => subscribers.delete(socket));
+    });
+
+    await new Promise<void>(resolve => server.listen(port, resolve));
+
+    const mock: MockVmix = {
+        port: (server.address() as AddressInfo).port,
+        program: 1,
+        preview: Math.min(2, inputs),
+        cut(input) {
+            const previous = mock.program;
+            mock.program = input ?? mock.preview;
+            mock.preview = previous;
+            publish();
+        },
+        setPreview(input) {
+            mock.preview = input;
+            publish();
+        },
+        close: () => new Promise<void>(resolve => {
+            subscribers.forEach(socket => socket.destroy());
+            server.close(() => resolve());
+        }),
+    };
+    return mock;
+};
+
+if (import.meta.url === pathToFileURL(process.argv[1]!).href) {
+    const {values: args} = parseArgs({
+        options: {
+            port: {type: 'string', default: '8099'},
+            inputs: {type: 'string', default: '8'},
+            interval: {type: 'string', default: '1000'},
+        },
+    });
+
+    const inputs = parseInt(args.inputs, 10);
+    const mock = await startMockVmix(parseInt(args.port, 10), inputs);
+    console.log(`mock vMix with ${inputs} inputs on port ${mock.port}, cutting every ${args.interval} ms`);
+    setInterval(() => {
+        mock.cut(mock.program % inputs + 1);
+    }, parseInt(args.interval, 10));
+}
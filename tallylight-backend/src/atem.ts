@@ -0,0 +1,271 @@
+import dgram from 'dgram';
+import {type LiveScenes, sceneKey} from './tally-index.js';
+
+// ATEM inputs show up as scenes of this pseudo instance (input number as scene), like vMix inputs
+export const atemInstance = 'atem';
+
+export const atemPort = 9910;
+
+// Every packet starts with a 12 byte header:
+//   flags (5 bits) and length (11 bits), session id, acked packet id, retransmit-from id, unused, packet id
+// followed by commands: length (uint16, header included), unused (uint16), 4 character name, data.
+export const atemHeaderLength = 12;
+export const atemFlagAckRequest = 0x01; // reliable, must be acked
+export const atemFlagHello = 0x02; // session handshake
+export const atemFlagRetransmit = 0x04; // a resend of an earlier packet
+export const atemFlagRetransmitRequest = 0x08; // asks for every packet from the retransmit-from id on
+export const atemFlagAck = 0x10;
+export const atemHelloLength = 20;
+export const atemHelloConnect = 0x01;
+export const atemHelloAccepted = 0x02;
+export const atemPacketIdMask = 0x7fff;
+
+// command names as big-endian uint32, so a command is identified without decoding a string
+const commandId = (name: string) => Buffer.from(name, 'ascii').readUInt32BE(0);
+export const atemProgramInput = commandId('PrgI');
+export const atemPreviewInput = commandId('PrvI');
+export const atemTallyByIndex = commandId('TlIn');
+export const atemInputProperties = commandId('InPr');
+export const atemInitComplete = commandId('InCm');
+
+// Source ids below this are external inputs. InPr also describes black (0) and the internal sources from 1000 on:
+// bars, colors, media players, ME outputs; those are not listed as scenes.
+export const atemFirstInternalSource = 1000;
+
+// TlIn bits per index
+const tallyProgram = 0x01;
+const tallyPreview = 0x02;
+
+const helloRetryMs = 1000;
+const timeoutMs = 5000;
+
+export const writeAtemHeader = (buf: Buffer, flags: number, sessionId: number, ackId: number, packetId: number, retransmitFrom = 0) => {
+    buf.writeUInt16BE(flags << 11 | buf.length & 0x07ff, 0);
+    buf.writeUInt16BE(sessionId, 2);
+    buf.writeUInt16BE(ackId, 4);
+    buf.writeUInt16BE(retransmitFrom, 6);
+    buf.writeUInt16BE(0, 8);
+    buf.writeUInt16BE(packetId, 10);
+};
+
+type AtemState = 'closed' | 'hello' | 'connected';
+
+// Client for the ATEM switcher UDP protocol: handshake, acks, retransmit requests and the commands needed for tally.
+// Reliable packets are applied strictly in order; a gap is asked for again instead of being skipped, so the tally
+// never misses a cut. Tally-by-index (TlIn) is used once the switcher has sent it, program/preview input of ME 1
+// before that.
+export class AtemClient {
+    readonly stats = {packets: 0, commands: 0, duplicates: 0, retransmitRequests: 0, changes: 0, connects: 0, timeouts: 0};
+    readonly names = new Map<number, string>(); // input -> long name, from InPr
+    programInput: number | null = null;
+    previewInput: number | null = null;
+
+    private socket: dgram.Socket | null = null;
+    private timer: NodeJS.Timeout | null = null;
+    private host = '';
+    private port = atemPort;
+    private state: AtemState = 'closed';
+    private sessionId = 0;
+    private lastPacketId = -1; // last reliable packet applied
+    private lastReceivedAt = 0;
+    private lastHelloAt = 0;
+
+    private tally = new Uint8Array(0); // TlIn, empty until received
+    private readonly program = new Set<string>();
+    private readonly preview = new Set<string>();
+    private live: LiveScenes | null = null;
+
+    constructor(private readonly onChange: () => void) {
+    }
+
+    get connected() {
+        return this.state === 'connected';
+    }
+
+    // external inputs, from TlIn once received, else from the InPr of external inputs
+    get inputCount() {
+        if (this.tally.length > 0) return this.tally.length;
+        let count = 0;
+        for (const input of this.names.keys()) {
+            if (input < atemFirstInternalSource) count = Math.max(count, input);
+        }
+        return count;
+    }
+
+    // host or host:port
+    start(address: string) {
+        this.stop();
+        const [host, port] = address.split(':');
+        this.host = host!;
+        this.port = port ? parseInt(port, 10) : atemPort;
+
+        const socket = dgram.createSocket('udp4');
+        socket.on('message', (msg) => this.receive(msg));
+        socket.on('error', (error) => {
+            console.warn('ATEM connection error:', error.message);
+        });
+        this.socket = socket;
+
+        this.hello();
+        this.timer = setInterval(() => this.check(), helloRetryMs / 4);
+    }
+
+    stop() {
+        if (this.timer) clearInterval(this.timer);
+        this.timer = null;
+        this.socket?.close();
+        this.socket = null;
+        this.state = 'closed';
+    }
+
+    // inputs on program/preview, as tally index keys; the same sets until the tally changes
+    liveScenes(): LiveScenes {
+        this.live ??= {program: new Set(this.program), preview: new Set(this.preview)};
+        return this.live;
+    }
+
+    // exposed for the benchmark, the socket feeds it the same way
+    receive(packet: Buffer) {
+        if (packet.length < atemHeaderLength) return;
+        const flags = packet[0]! >> 3;
+        const length = packet.readUInt16BE(0) & 0x07ff;
+        if (length > packet.length) return;
+
+        this.stats.packets++;
+        this.lastReceivedAt = Date.now();
+        this.sessionId = packet.readUInt16BE(2);
+
+        if (flags & atemFlagHello) {
+            if (this.state === 'hello' && packet[atemHeaderLength] === atemHelloAccepted) {
+                // the switcher answers with the state dump once the hello is acked
+                this.lastPacketId = 0;
+                this.send(this.ack(0));
+            }
+            return;
+        }
+
+        if (!(flags & atemFlagAckRequest)) return;
+
+        const packetId = packet.readUInt16BE(10);
+        const expected = (this.lastPacketId + 1) & atemPacketIdMask;
+        const ahead = (packetId - expected) & atemPacketIdMask;
+
+        if (ahead === 0) {
+            this.lastPacketId = packetId;
+            this.send(this.ack(packetId));
+            this.commands(packet, atemHeaderLength, length);
+        } else if (ahead > atemPacketIdMask / 2) {
+            // already applied, the switcher did not get our ack
+            this.stats.duplicates++;
+            this.send(this.ack(packetId));
+        } else {
+            // one went missing, it has to be applied first
+            this.stats.retransmitRequests++;
+            const request = Buffer.alloc(atemHeaderLength);
+            writeAtemHeader(request, atemFlagRetransmitRequest, this.sessionId, 0, 0, expected);
+            this.send(request);
+        }
+    }
+
+    private hello() {
+        this.state = 'hello';
+        this.lastHelloAt = Date.now();
+        this.sessionId = Math.floor(Math.random() * 0x7fff);
+        this.tally = new Uint8Array(0);
+
+        const hello = Buffer.alloc(atemHelloLength);
+        writeAtemHeader(hello, atemFlagHello, this.sessionId, 0, 0);
+        hello[atemHeaderLength] = atemHelloConnect;
+        this.send(hello);
+    }
+
+    private check() {
+        const now = Date.now();
+        if (this.state === 'hello' && now - this.lastHelloAt > helloRetryMs) {
+            this.hello();
+        } else if (this.state === 'connected' && now - this.lastReceivedAt > timeoutMs) {
+            // the switcher pings about every half second, it is gone; inputs keep their last state meanwhile
+            this.stats.timeouts++;
+            console.warn(`ATEM at ${this.host}:${this.port} timed out, reconnecting`);
+            this.hello();
+        }
+    }
+
+    // a new buffer each time, the socket still owns the previous one until it is sent
+    private ack(packetId: number) {
+        const ack = Buffer.alloc(atemHeaderLength);
+        writeAtemHeader(ack, atemFlagAck, this.sessionId, packetId, 0);
+        return ack;
+    }
+
+    private send(packet: Buffer) {
+        this.socket?.send(packet, this.port, this.host);
+    }
+
+    private commands(packet: Buffer, start: number, end: number) {
+        let changed = false;
+        let offset = start;
+        while (offset + 8 <= end) {
+            const length = packet.readUInt16BE(offset);
+            if (length < 8 || offset + length > end) break;
+            const id = packet.readUInt32BE(offset + 4);
+            const data = offset + 8;
+            this.stats.commands++;
+
+            if (id === atemProgramInput && packet[data] === 0) {
+                const input = packet.readUInt16BE(data + 2);
+                changed = this.programInput !== input || changed;
+                this.programInput = input;
+            } else if (id === atemPreviewInput && packet[data] === 0) {
+                const input = packet.readUInt16BE(data + 2);
+                changed = this.previewInput !== input || changed;
+                this.previewInput = input;
+            } else if (id === atemTallyByIndex) {
+                changed = this.applyTally(packet, data + 2, Math.min(packet.readUInt16BE(data), length - 10)) || changed;
+            } else if (id === atemInputProperties) {
+                const nameEnd = packet.indexOf(0, data + 2);
+                this.names.set(packet.readUInt16BE(data), packet.toString('utf8', data + 2, nameEnd < 0 || nameEnd > data + 22 ? data + 22 : nameEnd));
+            } else if (id === atemInitComplete && this.state !== 'connected') {
+                this.state = 'connected';
+                this.stats.connects++;
+                console.log(`Connected to ATEM at ${this.host}:${this.port}`);
+            }
+            offset += length;
+        }
+
+        if (changed) {
+            this.rebuild();
+            this.stats.changes++;
+            this.onChange();
+        }
+    }
+
+    private applyTally(packet: Buffer, start: number, count: number): boolean {
+        let changed = count !== this.tally.length;
+        if (changed) this.tally = new Uint8Array(count);
+        for (let i = 0; i < count; i++) {
+            const bits = packet[start + i]! & (tallyProgram | tallyPreview);
+            if (bits !== this.tally[i]) {
+                this.tally[i] = bits;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    private rebuild() {
+        this.program.clear();
+        this.preview.clear();
+        if (this.tally.length > 0) {
+            // TlIn index 0 is input 1
+            this.tally.forEach((bits, i) => {
+                if (bits & tallyProgram) this.program.add(sceneKey(atemInstance, String(i + 1)));
+                if (bits & tallyPreview) this.preview.add(sceneKey(atemInstance, String(i + 1)));
+            });
+        } else {
+            if (this.programInput !== null) this.program.add(sceneKey(atemInstance, String(this.programInput)));
+            if (this.previewInput !== null) this.preview.add(sceneKey(atemInstance, String(this.previewInput)));
+        }
+        this.live = null;
+    }
+}
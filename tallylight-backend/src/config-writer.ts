@@ -0,0 +1,91 @@
+import fs from 'fs/promises';
+import path from 'path';
+
+const retryMs = 5000;
+
+// Write-behind for the config file. Changes within delayMs are written together, off the request path. The file
+// is replaced atomically: written to a temp file, fsynced and renamed over the old one, so a crash or power loss
+// leaves the old or the new config, never a truncated one.
+export class ConfigWriter {
+    readonly stats = {requests: 0, writes: 0, failures: 0};
+
+    private timer: NodeJS.Timeout | null = null;
+    private writing: Promise<void> | null = null;
+    private dirty = false;
+
+    constructor(private readonly file: string, private readonly serialize: () => string, private readonly delayMs = 250) {
+    }
+
+    // the state at the time of the write is saved, so later changes in the window are included
+    schedule() {
+        this.stats.requests++;
+        this.dirty = true;
+        this.arm(this.delayMs);
+    }
+
+    // writes whatever is pending now, e.g. before exit
+    async flush() {
+        if (this.timer) {
+            clearTimeout(this.timer);
+            this.timer = null;
+        }
+        await this.write();
+    }
+
+    private arm(delayMs: number) {
+        this.timer ??= setTimeout(() => {
+            this.timer = null;
+            void this.write();
+        }, delayMs);
+    }
+
+    private async write() {
+        // one write at a time, changes made meanwhile go out with the next one
+        while (this.writing) await this.writing;
+        if (!this.dirty) return;
+        this.dirty = false;
+
+        this.writing = this.replace(this.serialize());
+        try {
+            await this.writing;
+        } finally {
+            this.writing = null;
+        }
+    }
+
+    private async replace(data: string) {
+        const temp = `${this.file}.tmp`;
+        try {
+            const handle = await fs.open(temp, 'w');
+            try {
+                await handle.writeFile(data, 'utf-8');
+                await handle.sync();
+            } finally {
+                await handle.close();
+            }
+            await fs.rename(temp, this.file);
+            await this.syncDirectory();
+            this.stats.writes++;
+            console.log('Configuration saved successfully');
+        } catch (error) {
+            this.stats.failures++;
+            console.error('Error saving configuration, retrying:', error);
+            this.dirty = true;
+            this.arm(retryMs);
+        }
+    }
+
+    // makes the rename itself durable; not every platform can open a directory, there the rename is still atomic
+    private async syncDirectory() {
+        try {
+            const handle = await fs.open(path.dirname(path.resolve(this.file)), 'r');
+            try {
+                await handle.sync();
+            } finally {
+                await handle.close();
+            }
+        } catch {
+            // ignored
+        }
+    }
+}
@@ -0,0 +1,120 @@
+import dgram from 'dgram';
+import crypto from 'crypto';
+
+// Authenticated binary command frames, see "Authenticated binary command frames" in the firmware.
+//   "TL" | version | command | nonce (u64, epoch seconds << 32 | counter) | length | payload | HMAC-SHA256[0..8]
+
+export const FRAME_VERSION = 1;
+export const FRAME_HEADER_SIZE = 13;
+export const FRAME_MAC_SIZE = 8;
+export const FRAME_REPLY = 0x80;
+
+export enum FrameCommand {
+    Set = 0x01,
+    Brightness = 0x02,
+    Identify = 0x03,
+    Ping = 0x04,
+}
+
+export const frameStatusNames = ['OK', 'REPLAYED', 'STALE', 'INVALID_PAYLOAD', 'UNKNOWN_COMMAND'] as const;
+
+export interface FrameReply {
+    status: number;
+    tallyState: number;
+    brightness: number;
+}
+
+export const signFrame = (key: string, data: Buffer): Buffer =>
+    crypto.createHmac('sha256', key).update(data).digest().subarray(0, FRAME_MAC_SIZE);
+
+export const encodeFrame = (key: string, command: number, nonce: bigint, payload: number[]): Buffer => {
+    const header = Buffer.alloc(FRAME_HEADER_SIZE);
+    header.write('TL', 0, 'ascii');
+    header.writeUInt8(FRAME_VERSION, 2);
+    header.writeUInt8(command, 3);
+    header.writeBigUInt64BE(nonce, 4);
+    header.writeUInt8(payload.length, 12);
+    const data = Buffer.concat([header, Buffer.from(payload)]);
+    return Buffer.concat([data, signFrame(key, data)]);
+};
+
+interface PendingFrame {
+    resolve: (reply: FrameReply) => void;
+    reject: (error: Error) => void;
+    timeout: NodeJS.Timeout;
+}
+
+export class FrameClient {
+    private readonly socket = dgram.createSocket('udp4');
+    private counter = 0;
+    private readonly pending = new Map<bigint, PendingFrame>();
+
+    constructor(public key: string) {
+        this.socket.on('message', (message) => this.onMessage(message));
+        this.socket.on('error', (error) => {
+            console.error('Frame socket error:', error);
+        });
+        this.socket.bind();
+    }
+
+    // nonces only have to increase per light, a single counter for all lights does that
+    private nextNonce(): bigint {
+        this.counter = (this.counter + 1) >>> 0;
+        return (BigInt(Math.floor(Date.now() / 1000)) << 32n) | BigInt(this.counter);
+    }
+
+    send(address: string, port: number, command: FrameCommand, payload: number[], timeoutMs = 1000): Promise<FrameReply> {
+        const nonce = this.nextNonce();
+        const frame = encodeFrame(this.key, command, nonce, payload);
+
+        return new Promise((resolve, reject) => {
+            const timeout = setTimeout(() => {
+                this.pending.delete(nonce);
+                reject(new Error('Frame reply timeout'));
+            }, timeoutMs);
+            this.pending.set(nonce, {resolve, reject, timeout});
+
+            this.socket.send(frame, port, address, (error) => {
+                if (error) {
+                    clearTimeout(timeout);
+                    this.pending.delete(nonce);
+                    reject(error);
+                }
+            });
+        });
+    }
+
+    close() {
+        for (const {reject, timeout} of this.pending.values()) {
+            clearTimeout(timeout);
+            reject(new Error('Frame client closed'));
+        }
+        this.pending.clear();
+        this.socket.close();
+    }
+
+    private onMessage(message: Buffer) {
+        if (message.length !== FRAME_HEADER_SIZE + 3 + FRAME_MAC_SIZE || message.toString('ascii', 0, 2) !== 'TL') {
+            return;
+        }
+
+        const signedLength = message.length - FRAME_MAC_SIZE;
+        const mac = signFrame(this.key, message.subarray(0, signedLength));
+        if (!crypto.timingSafeEqual(mac, message.subarray(signedLength))) {
+            console.warn('Dropping frame reply with invalid MAC');
+            return;
+        }
+
+        const nonce = message.readBigUInt64BE(4);
+        const pending = this.pending.get(nonce);
+        if (!pending) return;
+
+        clearTimeout(pending.timeout);
+        this.pending.delete(nonce);
+        pending.resolve({
+            status: message.readUInt8(FRAME_HEADER_SIZE),
+            tallyState: message.readUInt8(FRAME_HEADER_SIZE + 1),
+            brightness: message.readUInt8(FRAME_HEADER_SIZE + 2),
+        });
+    }
+}
@@ -2,32 +2,50 @@ import {Bonjour, Browser, Service} from 'bonjour-service';
 import express from 'express';
 import fs from 'fs';
 import cors from 'cors';
-import {OBSWebSocket} from 'obs-websocket-js';
-
-const obs = new OBSWebSocket();
-
-// connect to localhost
+import {MqttPublisher} from './mqtt.js';
+import {FrameClient, FrameCommand, frameStatusNames} from './frames.js';
+import {LedMirror} from './mirror.js';
+import {CoalescingScheduler} from './scheduler.js';
+import {LatencyRecorder} from './latency.js';
+import {type LiveScenes, liveScenesOf, sceneKey, TallyIndex} from './tally-index.js';
+import {ObsInstance, type ObsChange, type ObsInstanceConfig} from './obs-instance.js';
+import {TslReceiver, tslInstance, tslPreview, tslProgram} from './tsl.js';
+import {TslSender} from './tsl-output.js';
+import {VmixClient, vmixInstance} from './vmix.js';
+import {AtemClient, atemInstance} from './atem.js';
+import {type Labels, MetricsRegistry} from './metrics.js';
+import {type Json, mergePatch} from './json-patch.js';
+import {ConfigWriter} from './config-writer.js';
+import type {FQDN, SceneUuid, TallyLightState} from './types.js';
 
 const tallyLightServices: { service: Service; lastPing: Date | null }[] = [];
 
-export type FQDN = string;
-
-export type SceneUuid = string;
-
-export type TallyLightState = 'OFF' | 'STANDBY' | 'PROGRAM' | 'PREVIEW' | 'ERROR';
-
-let obsConnected = false;
+export interface SceneRef {
+    instance: string; // ObsInstanceConfig.id
+    sceneUuid: SceneUuid;
+}
 
 export interface TallyLightMapping {
     brightness: number; // 0-255
-    visibleInScenes: SceneUuid[];
+    visibleInScenes: SceneRef[];
+    tslIndex?: number; // display index the light's tally is published as over TSL UMD, see tslOutputs
 }
 
+// how the program/preview of several OBS instances combine:
+//   any:      a light is live if it is live in any connected instance
+//   priority: only the first connected instance (in config order) counts, the others are backups
+export type ObsMergePolicy = 'any' | 'priority';
+
 export interface ServerConfig {
     lights: Record<FQDN, TallyLightMapping>;
-    obsAddress: string;
-    obsPassword: string;
+    obsInstances: ObsInstanceConfig[];
+    obsMergePolicy: ObsMergePolicy;
     apiKey: string;
+    mqttUrl: string; // e.g. mqtt://localhost:1883, empty to use HTTP
+    tslPort: number; // UDP port to receive TSL UMD v3.1/v5 tally on, 0 to disable
+    tslOutputs: string[]; // udp://host:port or tcp://host:port, consumers of the lights' tally as TSL UMD v5
+    vmixAddress: string; // host or host:port of the vMix TCP API, empty to disable
+    atemAddress: string; // host or host:port of an ATEM switcher, empty to disable
     version: number;
 }
 
@@ -81,18 +99,122 @@ export interface TallylightInfo {
 
 const tallylightInfos: Record<FQDN, TallylightInfo> = {};
 
-const currentState: {
-    previewSceneUuid: SceneUuid | null;
-    programSceneUuid: SceneUuid | null
-} = {previewSceneUuid: null, programSceneUuid: null};
+// capability document served by the firmware at /capabilities, see buildCapabilities() in main.cpp
+export interface TallylightCapabilities {
+    v: number;
+    gitHash: string;
+    protocols: string[];
+    ports: Record<string, number>;
+    states: TallyLightState[];
+    sources: string[];
+    ledCount: number;
+    zones: number;
+    maxFps: number;
+    maxBatchOps: number;
+    features: string[];
+}
+
+// firmware from before /capabilities only speaks the plain HTTP API
+const legacyCapabilities = (gitHash: string): TallylightCapabilities => ({
+    v: 0,
+    gitHash,
+    protocols: ['http'],
+    ports: {},
+    states: ['OFF', 'STANDBY', 'PROGRAM', 'PREVIEW', 'ERROR'],
+    sources: [],
+    ledCount: 6,
+    zones: 1,
+    maxFps: 0,
+    maxBatchOps: 0,
+    features: [],
+});
+
+// the document only depends on the build, so it is fetched once per firmware version, not per light
+const capabilitiesByGitHash = new Map<string, TallylightCapabilities>();
+
+export type TallyLightProtocol = 'mqtt' | 'udp-frame' | 'http';
+
+// OBS connections by id, in config order (the order matters for the priority merge policy)
+const obsInstances = new Map<string, ObsInstance>();
+
+// time from a tally source event until the first light accepted the resulting state
+const eventToFirstLight = new LatencyRecorder();
+let pendingEventAt: number | null = null;
+let pendingEventSource = 'obs';
+// the same event for the metrics, taken by the next update
+let pendingUpdateEvent: { source: string; at: number } | null = null;
+
+// Prometheus metrics, served at /metrics. Values the backend already tracks are collected at scrape time.
+const metrics = new MetricsRegistry();
+const eventToUpdateSeconds = metrics.histogram('tally_event_to_update_seconds', 'Time from a tally source event until the update handling it starts, by source');
+const eventToFirstLightSeconds = metrics.histogram('tally_event_to_first_light_seconds', 'Time from a tally source event until the first light accepted the resulting state, by source');
+const updateSeconds = metrics.histogram('tally_update_seconds', 'Time to compute an update and start sending it, by kind (full or incremental)');
+const lightSetSeconds = metrics.histogram('tally_light_set_seconds', 'Time to send a state to a light, by selected protocol and result');
+const lightPingSeconds = metrics.histogram('tally_light_ping_seconds', 'Round trip time of pings to the lights');
+const apiDataSeconds = metrics.histogram('tally_api_data_seconds', 'Time to serve /api/data');
+const lightTimeouts = metrics.counter('tally_light_timeouts_total', 'HTTP requests to lights that hit their timeout, by request');
+const mdnsEvents = metrics.counter('tally_mdns_events_total', 'Tally light services coming up, going down or expiring without pings');
+metrics.counter('tally_fanout_total', 'States sent to lights, skipped as already acked, or re-sent by reconciliation', () => [
+    [{result: 'sent'}, fanOutStats.sent],
+    [{result: 'skipped'}, fanOutStats.skipped],
+    [{result: 'reconciled'}, fanOutStats.reconciled],
+]);
+metrics.gauge('tally_lights_configured', 'Configured tally lights', () => Object.keys(serverConfig.lights).length);
+metrics.gauge('tally_lights_discovered', 'Tally light services currently known from mDNS', () => tallyLightServices.length);
+metrics.gauge('tally_lights_by_state', 'Configured tally lights by their last acked state', () => {
+    const counts = new Map<string, number>();
+    for (const fqdn of Object.keys(serverConfig.lights)) {
+        const state = lastAckedState[fqdn]?.state ?? 'unacked';
+        counts.set(state, (counts.get(state) ?? 0) + 1);
+    }
+    return [...counts].map(([state, count]) => [{state}, count]);
+});
+metrics.gauge('tally_source_connected', 'Whether each configured tally source is connected', () => {
+    const sources: [Labels, number][] = [...obsInstances.values()].map(instance => [{source: 'obs', instance: instance.id}, instance.connected ? 1 : 0]);
+    if (serverConfig.vmixAddress) sources.push([{source: 'vmix', instance: vmixInstance}, vmixClient.connected ? 1 : 0]);
+    if (serverConfig.atemAddress) sources.push([{source: 'atem', instance: atemInstance}, atemClient.connected ? 1 : 0]);
+    return sources;
+});
+
+const noteTallyEvent = (source: string) => {
+    const now = performance.now();
+    if (pendingEventAt === null) {
+        pendingEventAt = now;
+        pendingEventSource = source;
+    }
+    pendingUpdateEvent ??= {source, at: now};
+};
 
 // Load server configuration
 const defaultConfig: ServerConfig = {
     lights: {},
-    obsAddress: 'ws://localhost:4455',
-    obsPassword: '',
+    obsInstances: [{id: 'main', address: 'ws://localhost:4455', password: ''}],
+    obsMergePolicy: 'any',
     apiKey: '',
-    version: 2
+    mqttUrl: '',
+    tslPort: 0,
+    tslOutputs: [],
+    vmixAddress: '',
+    atemAddress: '',
+    version: 8
+};
+
+// version 3 and older had a single OBS connection and plain scene uuids in visibleInScenes
+const migrateToObsInstances = (config: ServerConfig & { obsAddress?: string; obsPassword?: string }) => {
+    if (config.version >= 4) return;
+
+    const id = defaultConfig.obsInstances[0]!.id;
+    config.obsInstances = [{
+        id,
+        address: config.obsAddress ?? defaultConfig.obsInstances[0]!.address,
+        password: config.obsPassword ?? '',
+    }];
+    delete config.obsAddress;
+    delete config.obsPassword;
+
+    for (const mapping of Object.values(config.lights ?? {})) {
+        mapping.visibleInScenes = ((mapping.visibleInScenes ?? []) as unknown as SceneUuid[]).map(sceneUuid => ({instance: id, sceneUuid}));
+    }
 };
 
 let serverConfig: ServerConfig = defaultConfig;
@@ -119,27 +241,124 @@ try {
 // if version does not match with default, merge
 if (serverConfig.version !== defaultConfig.version) {
     console.warn('Configuration version mismatch, merging with default');
+    migrateToObsInstances(serverConfig);
     serverConfig = {...defaultConfig, ...serverConfig, version: defaultConfig.version};
     fs.writeFileSync(configPath, JSON.stringify(serverConfig, null, 2), 'utf-8');
     console.log('Configuration updated to version', serverConfig.version);
 }
 
-for (const fqdn of Object.keys(serverConfig.lights)) {
+const tallyIndex = new TallyIndex();
+
+function sceneKeysOf(mapping: TallyLightMapping) {
+    return mapping.visibleInScenes.map(ref => sceneKey(ref.instance, ref.sceneUuid));
+}
+
+for (const [fqdn, mapping] of Object.entries(serverConfig.lights)) {
     currentLightState[fqdn] = 'OFF';
+    tallyIndex.setLightScenes(fqdn, sceneKeysOf(mapping));
 }
 
-export const updateConfig = async () => {
-    try {
-        fs.writeFileSync(configPath, JSON.stringify(serverConfig, null, 2), 'utf-8');
-        console.log('Configuration saved successfully');
-    } catch (error) {
-        console.error('Error saving configuration:', error);
+const configWriter = new ConfigWriter(configPath, () => JSON.stringify(serverConfig, null, 2));
+
+// Saves the config in the background and updates the lights. The update does not wait for the file; changedLight
+// limits it to that light, without it every light is recomputed.
+export const updateConfig = (changedLight?: FQDN) => {
+    configWriter.schedule();
+    return changedLight ? scheduleLightUpdate(changedLight) : scheduleUpdate();
+};
+
+let mqtt: MqttPublisher | null = null;
+
+const frameClient = new FrameClient(serverConfig.apiKey);
+
+// tally from hardware switchers, its displays are scenes of the 'tsl' instance, see tsl.ts
+const tslReceiver = new TslReceiver((_display, tallyChanged) => {
+    if (!tallyChanged) return;
+    noteTallyEvent('tsl');
+    scheduleSceneUpdate().catch(error => {
+        console.error('Error updating lights after TSL UMD change:', error);
+    });
+});
+
+// tally from vMix, its inputs are scenes of the 'vmix' instance, see vmix.ts
+const vmixClient = new VmixClient(() => {
+    noteTallyEvent('vmix');
+    scheduleSceneUpdate().catch(error => {
+        console.error('Error updating lights after vMix tally change:', error);
+    });
+});
+
+const restartVmix = () => {
+    vmixClient.stop();
+    if (serverConfig.vmixAddress) {
+        vmixClient.start(serverConfig.vmixAddress);
     }
+};
 
-    await handleUpdate();
+// tally from an ATEM switcher, its inputs are scenes of the 'atem' instance, see atem.ts
+const atemClient = new AtemClient(() => {
+    noteTallyEvent('atem');
+    scheduleSceneUpdate().catch(error => {
+        console.error('Error updating lights after ATEM tally change:', error);
+    });
+});
+
+const restartAtem = () => {
+    atemClient.stop();
+    if (serverConfig.atemAddress) {
+        atemClient.start(serverConfig.atemAddress);
+    }
+};
+
+// the computed tally of every light with a tslIndex, for multiviewers and other tally consumers
+const tslSender = new TslSender();
+
+const tslTallyOf = (state: TallyLightState) => state === 'PROGRAM' ? tslProgram : state === 'PREVIEW' ? tslPreview : 0;
+
+const restartTslOutput = () => {
+    tslSender.setTargets(serverConfig.tslOutputs);
+};
+
+const restartTsl = () => {
+    tslReceiver.stop();
+    if (serverConfig.tslPort) {
+        tslReceiver.start(serverConfig.tslPort);
+    }
+};
+
+const restartMqtt = () => {
+    mqtt?.stop();
+    mqtt = null;
+    // a new broker has none of our retained states
+    forgetAckedState();
+
+    if (serverConfig.mqttUrl) {
+        mqtt = new MqttPublisher(serverConfig.mqttUrl, `tallylight-backend-${process.pid}`);
+        mqtt.start();
+    }
 };
 
+// the firmware uses its hostname as MQTT topic, which is the first label of the mDNS FQDN
+export const mqttStateTopic = (tallyLightFqdn: FQDN) => `tallylight/${tallyLightFqdn.split('.')[0]}/state`;
+
 export const setTallyLightState = async (tallyLightFqdn: FQDN, state: TallyLightState): Promise<SetTallyLightStateResponse> => {
+    const brightness = serverConfig.lights[tallyLightFqdn]?.brightness || 255;
+
+    const protocol = selectProtocol(tallyLightFqdn);
+
+    // publish retained state, the light picks it up as soon as it (re)connects to the broker,
+    // so it does not matter whether it is currently online
+    if (protocol === 'mqtt' && mqtt) {
+        try {
+            await mqtt.publish(mqttStateTopic(tallyLightFqdn), JSON.stringify({state, brightness}), {qos: 1, retain: true});
+            return {success: true, tallyState: state, brightness};
+        } catch (error) {
+            if (error instanceof Error) {
+                console.warn(`Error publishing state for ${tallyLightFqdn}, falling back to HTTP:`, error.message);
+            }
+        }
+    }
+
     const service = tallyLightServices.find(s => s.service.fqdn === tallyLightFqdn)?.service;
     if (!service) {
         return {success: false, error: new TallyLightOfflineError(`Tally light with FQDN ${tallyLightFqdn} not online`)};
@@ -150,8 +369,22 @@ export const setTallyLightState = async (tallyLightFqdn: FQDN, state: TallyLight
         return {success: false, error: 'Tally light has no addresses'};
     }
 
-    const brightness = serverConfig.lights[tallyLightFqdn]?.brightness || 255;
-
+    const capabilities = getCapabilities(tallyLightFqdn);
+    const stateId = capabilities?.states.indexOf(state) ?? -1;
+    if (protocol === 'udp-frame' && capabilities && stateId >= 0) {
+        frameClient.key = serverConfig.apiKey;
+        try {
+            const reply = await frameClient.send(service.addresses[0]!, capabilities.ports['udp-frame']!, FrameCommand.Set, [stateId, brightness]);
+            if (reply.status === 0) {
+                return {success: true, tallyState: capabilities.states[reply.tallyState] ?? state, brightness: reply.brightness};
+            }
+            console.warn(`Frame for ${tallyLightFqdn} rejected:`, frameStatusNames[reply.status] ?? reply.status);
+        } catch (error) {
+            if (error instanceof Error) {
+                console.warn(`Error sending frame to ${tallyLightFqdn}, falling back to HTTP:`, error.message);
+            }
+        }
+    }
 
     const url = `http://${service.addresses[0]}:${service.port}/set?state=${state}&brightness=${brightness}&apiKey=${serverConfig.apiKey}`;
 
@@ -180,6 +413,7 @@ export const setTallyLightState = async (tallyLightFqdn: FQDN, state: TallyLight
         }
     } catch (error) {
         if (error instanceof Error) {
+            if (error.name === 'AbortError') lightTimeouts.inc({request: 'set'});
             console.warn(`Error setting state for ${tallyLightFqdn}:`, error.message);
         }
         return {success: false, error: 'Network error'};
@@ -207,6 +441,7 @@ export const sendPing = async (tallyLightFqdn: FQDN): Promise<boolean> => {
 
     const url = `http://${service.addresses[0]}:${service.port}/ping`;
 
+    const observePing = lightPingSeconds.startTimer();
     const abortController = new AbortController();
     // timeout of 3s
     const timeout = setTimeout(() => {
@@ -220,6 +455,7 @@ export const sendPing = async (tallyLightFqdn: FQDN): Promise<boolean> => {
             console.error(`Failed to ping ${tallyLightFqdn}:`, response.statusText);
             return false;
         }
+        observePing();
 
         // set last ping time
         const light = tallyLightServices.find(s => s.service.fqdn === tallyLightFqdn);
@@ -229,7 +465,9 @@ export const sendPing = async (tallyLightFqdn: FQDN): Promise<boolean> => {
 
         return true;
     } catch (error) {
-        if (!(error instanceof Error && error.name === 'AbortError')) {
+        if (error instanceof Error && error.name === 'AbortError') {
+            lightTimeouts.inc({request: 'ping'});
+        } else {
             console.error(`Error pinging ${tallyLightFqdn}:`, error);
         }
         return false;
@@ -307,6 +545,11 @@ export const fetchTallylightInfos = async (tallyLightFqdn: FQDN): Promise<Tallyl
         }
         const result = await response.json() as TallylightInfo;
         tallylightInfos[tallyLightFqdn] = result;
+
+        if (!capabilitiesByGitHash.has(result.gitHash)) {
+            await fetchCapabilities(`http://${service.addresses[0]}:${service.port}`, result.gitHash);
+        }
+
         return result;
     } catch (error) {
         if (error instanceof Error) {
@@ -319,6 +562,55 @@ export const fetchTallylightInfos = async (tallyLightFqdn: FQDN): Promise<Tallyl
     return null;
 };
 
+const fetchCapabilities = async (baseUrl: string, gitHash: string): Promise<void> => {
+    const abortController = new AbortController();
+    const timeout = setTimeout(() => {
+        abortController.abort();
+    }, 3000);
+
+    try {
+        const response = await fetch(`${baseUrl}/capabilities`, {signal: abortController.signal});
+        clearTimeout(timeout);
+        if (response.status === 404) {
+            capabilitiesByGitHash.set(gitHash, legacyCapabilities(gitHash));
+            return;
+        }
+        if (!response.ok) {
+            // retried with the next info fetch
+            console.warn(`Failed to fetch capabilities of ${gitHash}:`, response.statusText);
+            return;
+        }
+        const capabilities = await response.json() as TallylightCapabilities;
+        capabilitiesByGitHash.set(gitHash, capabilities);
+        console.log(`Firmware ${gitHash} supports`, capabilities.protocols.join(', '));
+    } catch (error) {
+        if (error instanceof Error && error.name !== 'AbortError') {
+            console.error(`Error fetching capabilities of ${gitHash}:`, error.message);
+        }
+    }
+};
+
+export const getCapabilities = (tallyLightFqdn: FQDN): TallylightCapabilities | null => {
+    const gitHash = tallylightInfos[tallyLightFqdn]?.gitHash;
+    return gitHash ? capabilitiesByGitHash.get(gitHash) ?? null : null;
+};
+
+// Fastest protocol first: a retained MQTT publish reaches the light even while it is offline, a signed UDP frame
+// is a single datagram without connection setup, HTTP is what every firmware version understands.
+// MQTT only once the light has said it subscribes: the broker acks a publish nobody reads, so a light without it
+// would never get its state.
+export const selectProtocol = (tallyLightFqdn: FQDN): TallyLightProtocol => {
+    const capabilities = getCapabilities(tallyLightFqdn);
+
+    if (mqtt?.connected && capabilities?.protocols.includes('mqtt')) {
+        return 'mqtt';
+    }
+    if (capabilities?.protocols.includes('udp-frame') && serverConfig.apiKey) {
+        return 'udp-frame';
+    }
+    return 'http';
+};
+
 export const restartTallyLight = async (tallyLightFqdn: FQDN): Promise<boolean> => {
     const service = tallyLightServices.find(s => s.service.fqdn === tallyLightFqdn)?.service;
     if (!service) {
@@ -363,6 +655,9 @@ export const restartTallyLight = async (tallyLightFqdn: FQDN): Promise<boolean>
 let instance: Bonjour | null = null;
 let instanceBrowser: Browser | null = null;
 
+const sameEndpoint = (a: Service, b: Service) => a.port === b.port
+    && [...a.addresses ?? []].sort().join() === [...b.addresses ?? []].sort().join();
+
 const restartServiceBrowser = () => {
     try {
         console.log('Restarting service browser to avoid potential issues');
@@ -378,14 +673,32 @@ const restartServiceBrowser = () => {
         instanceBrowser = instance.find({type: 'tallylight'});
 
         instanceBrowser.on('up', async (service) => {
-            tallyLightServices.push({ service, lastPing: null });
+            mdnsEvents.inc({event: 'up'});
+            const known = tallyLightServices.find(s => s.service.fqdn === service.fqdn);
+            if (known && sameEndpoint(known.service, service)) {
+                // re-announced, e.g. after the browser restart every minute; the pings tell if it rebooted
+                known.service = service;
+                scheduleUiPush();
+                return;
+            }
+
+            if (known) {
+                known.service = service;
+                known.lastPing = null;
+            } else {
+                tallyLightServices.push({ service, lastPing: null });
+            }
             console.log('Found tally light service:', service.fqdn);
-            await handleUpdate();
+            // new or moved, it may have rebooted since we last sent to it
+            forgetAckedState(service.fqdn);
+            await scheduleLightUpdate(service.fqdn);
             await sendPing(service.fqdn);
         });
 
         instanceBrowser.on('down', (service) => {
             console.log('Tally light service went down:', service.fqdn);
+            mdnsEvents.inc({event: 'down'});
+            scheduleUiPush();
 
             const index = tallyLightServices.findIndex(s => s.service.fqdn === service.fqdn);
             if (index !== -1) {
@@ -415,31 +728,45 @@ setInterval(() => {
         if (lastPing && (now.getTime() - lastPing.getTime() > 15000)) {
             console.log('Removing tally light service due to timeout:', service.fqdn);
             tallyLightServices.splice(i, 1);
+            mdnsEvents.inc({event: 'expired'});
             removed = true;
         }
     }
     if (removed) {
-        handleUpdate().catch(error => {
+        scheduleUpdate().catch(error => {
             console.error('Error updating lights after removing timed out services:', error);
         });
     }
 }, 5000);
 
-const restartObsWebSocket = async () => {
-    try {
-        obsConnected = false;
-        await obs.disconnect();
-    } catch (error) {
-        console.error('Error disconnecting from OBS:', error);
+// Brings the connections in line with serverConfig.obsInstances: connects new instances, reconnects those whose
+// address or password changed and disconnects removed ones. Untouched instances keep their connection and state.
+const syncObsInstances = async () => {
+    const previous = new Map(obsInstances);
+    obsInstances.clear();
+
+    const starting: Promise<void>[] = [];
+    for (const config of serverConfig.obsInstances) {
+        let instance = previous.get(config.id);
+        previous.delete(config.id);
+
+        if (instance && (instance.config.address !== config.address || instance.config.password !== config.password)) {
+            await instance.stop();
+            instance = undefined;
+        }
+        if (!instance) {
+            instance = new ObsInstance({...config}, onObsChange);
+            starting.push(instance.start());
+        }
+        obsInstances.set(config.id, instance);
     }
 
-    try {
-        await obs.connect(serverConfig.obsAddress, serverConfig.obsPassword);
-        obsConnected = true;
-        console.log('Reconnected to OBS successfully');
-    } catch (error) {
-        console.error('Failed to reconnect to OBS:', error);
+    for (const removed of previous.values()) {
+        await removed.stop();
     }
+
+    await Promise.all(starting);
+    await scheduleSceneUpdate();
 };
 
 const app = express();
@@ -448,40 +775,235 @@ app.use(cors());
 
 app.use(express.json());
 
-app.get('/api/data', async (_req, res) => {
-    let scenes: object[] = [];
+// what the UI shows, served by /api/data and pushed by /api/events; from memory, without calls to OBS
+const collectData = () => {
+    const connectedInstances = [...obsInstances.values()].filter(instance => instance.connected);
+    const scenes: object[] = connectedInstances.flatMap(instance => instance.sceneList);
+
+    for (let input = 1; input <= vmixClient.inputCount; input++) {
+        const title = vmixClient.titles.get(input);
+        scenes.push({
+            instance: vmixInstance,
+            sceneUuid: String(input),
+            sceneName: title ? `${input}: ${title}` : `Input ${input}`,
+            sceneIndex: input,
+        });
+    }
 
-    try {
-        scenes = (await obs.call('GetSceneList')).scenes;
-    } catch (error) {
-        console.error('Error fetching scenes from OBS:', error);
+    for (let input = 1; input <= atemClient.inputCount; input++) {
+        const name = atemClient.names.get(input);
+        scenes.push({
+            instance: atemInstance,
+            sceneUuid: String(input),
+            sceneName: name ? `${input}: ${name}` : `Input ${input}`,
+            sceneIndex: input,
+        });
     }
 
-    try {
-        res.json({
-            lightsFound: tallyLightServices.map(({ service, lastPing }) => ({
-                name: service.name,
-                type: service.type,
-                protocol: service.protocol,
-                port: service.port,
-                host: service.host,
-                fqdn: service.fqdn,
-                addresses: service.addresses,
-                txt: service.txt,
-                lastPing,
-            })),
-            scenes,
-            configuredLights: serverConfig.lights,
-            currentLightState,
-            obsConnected,
-            tallylightInfos,
+    for (const display of tslReceiver.displays.values()) {
+        scenes.push({
+            instance: tslInstance,
+            sceneUuid: `${display.screen}:${display.index}`,
+            sceneName: display.label ? `${display.index}: ${display.label}` : `Display ${display.index}`,
+            sceneIndex: display.index,
         });
+    }
+
+    return {
+        lightsFound: tallyLightServices.map(({ service }) => ({
+            name: service.name,
+            type: service.type,
+            protocol: service.protocol,
+            port: service.port,
+            host: service.host,
+            fqdn: service.fqdn,
+            addresses: service.addresses,
+            txt: service.txt,
+        })),
+        // apart from lightsFound, which then only changes on discovery
+        lastPings: Object.fromEntries(tallyLightServices.map(({ service, lastPing }) => [service.fqdn, lastPing])),
+        scenes,
+        configuredLights: serverConfig.lights,
+        currentLightState,
+        obsConnected: connectedInstances.length > 0,
+        obsInstances: [...obsInstances.values()].map(instance => ({
+            id: instance.id,
+            address: instance.config.address,
+            connected: instance.connected,
+            sceneModel: {
+                ...instance.model.stats,
+                sequence: instance.model.sequence,
+                programSceneUuid: instance.model.programSceneUuid,
+                previewSceneUuid: instance.model.previewSceneUuid,
+                studioModeEnabled: instance.model.studioModeEnabled,
+            },
+            sceneGraph: instance.graph.stats,
+        })),
+        obsMergePolicy: serverConfig.obsMergePolicy,
+        tsl: {...tslReceiver.stats, displays: tslReceiver.displays.size},
+        tslOutput: {...tslSender.stats, tcpConnected: tslSender.tcpConnected},
+        vmix: {...vmixClient.stats, connected: vmixClient.connected, inputs: vmixClient.inputCount},
+        atem: {
+            ...atemClient.stats,
+            connected: atemClient.connected,
+            programInput: atemClient.programInput,
+            previewInput: atemClient.previewInput,
+        },
+        mqttConnected: mqtt?.connected ?? false,
+        configWrites: configWriter.stats,
+        fanOut: fanOutStats,
+        updates: updateScheduler.stats,
+        eventToFirstLight: eventToFirstLight.stats,
+        tallylightInfos,
+        capabilities: Object.fromEntries(Object.keys(tallylightInfos).map(fqdn => [fqdn, getCapabilities(fqdn)])),
+        protocols: Object.fromEntries(Object.keys(serverConfig.lights).map(fqdn => [fqdn, selectProtocol(fqdn)])),
+    };
+};
+
+app.get('/api/data', async (_req, res) => {
+    const observe = apiDataSeconds.startTimer();
+    res.on('finish', () => observe());
+    try {
+        res.json(collectData());
     } catch (error) {
         console.error('Error fetching list:', error);
         res.status(500).json({error: 'Internal Server Error'});
     }
 });
 
+// Push channel for the UI, replaces polling /api/data.
+//   event "snapshot": the /api/data document, on connect
+//   event "delta":    JSON merge patch against the previous document, see json-patch.ts
+// The document is collected and diffed once per push, not per client. A new client gets its snapshot from the
+// same run, so it starts from the document the next delta is based on.
+const uiClients = new Set<express.Response>();
+const uiJoining = new Set<express.Response>();
+let uiDocument: Json | null = null; // as last sent to the clients
+
+const pushUi = async () => {
+    if (uiClients.size === 0 && uiJoining.size === 0) return;
+    // through JSON, so dates and undefined compare the way the browser will see them
+    const next = JSON.parse(JSON.stringify(collectData())) as Json;
+    const patch = uiDocument === null ? undefined : mergePatch(uiDocument, next);
+    uiDocument = next;
+
+    if (patch !== undefined) {
+        const message = `event: delta\ndata: ${JSON.stringify(patch)}\n\n`;
+        for (const client of uiClients) {
+            client.write(message);
+        }
+    }
+
+    if (uiJoining.size > 0) {
+        const message = `event: snapshot\ndata: ${JSON.stringify(next)}\n\n`;
+        for (const client of uiJoining) {
+            client.write(message);
+            uiClients.add(client);
+        }
+        uiJoining.clear();
+    }
+};
+
+// the window merges the bursts of a cut (scene events, update, acks) into one delta
+const uiScheduler = new CoalescingScheduler(pushUi, 50);
+
+const scheduleUiPush = () => {
+    if (uiClients.size === 0 && uiJoining.size === 0) return;
+    void uiScheduler.request();
+};
+
+// stats, pings and light infos change without an update, they go out at the old polling pace
+setInterval(scheduleUiPush, 1500);
+
+app.get('/api/events', (req, res) => {
+    res.writeHead(200, {
+        'Content-Type': 'text/event-stream',
+        'Cache-Control': 'no-cache',
+        Connection: 'keep-alive',
+    });
+
+    uiJoining.add(res);
+    scheduleUiPush();
+
+    req.on('close', () => {
+        uiJoining.delete(res);
+        uiClients.delete(res);
+    });
+});
+
+
+// Live LED preview. The browser cannot reach the lights directly, so the backend subscribes to each configured
+// light's /leds stream while at least one UI is watching and relays the lights' deltas unchanged.
+//   event "snapshot": {[fqdn]: {brightness, leds}}   on connect
+//   event "frame":    {fqdn, brightness, leds}        light (re)connected or sent a keyframe
+//   event "delta":    {fqdn, brightness, changed}
+const ledMirrors = new Map<FQDN, LedMirror>();
+const ledPreviewClients = new Set<express.Response>();
+
+const broadcastLedEvent = (event: string, data: object) => {
+    const message = `event: ${event}\ndata: ${JSON.stringify(data)}\n\n`;
+    for (const client of ledPreviewClients) {
+        client.write(message);
+    }
+};
+
+const syncLedMirrors = () => {
+    const wanted = new Map<FQDN, string>();
+    if (ledPreviewClients.size > 0) {
+        for (const fqdn of Object.keys(serverConfig.lights)) {
+            const service = tallyLightServices.find(s => s.service.fqdn === fqdn)?.service;
+            if (service?.addresses && service.addresses.length > 0) {
+                wanted.set(fqdn, `http://${service.addresses[0]}:${service.port}/leds`);
+            }
+        }
+    }
+
+    for (const [fqdn, mirror] of ledMirrors) {
+        if (!wanted.has(fqdn)) {
+            mirror.stop();
+            ledMirrors.delete(fqdn);
+        }
+    }
+
+    for (const [fqdn, url] of wanted) {
+        if (ledMirrors.has(fqdn)) continue;
+        const mirror = new LedMirror(url,
+            (frame) => broadcastLedEvent('frame', {fqdn, ...frame}),
+            (delta) => broadcastLedEvent('delta', {fqdn, ...delta}));
+        ledMirrors.set(fqdn, mirror);
+        mirror.start();
+    }
+};
+
+// picks up lights that were added or (re)discovered while someone is watching
+setInterval(() => {
+    if (ledPreviewClients.size > 0) syncLedMirrors();
+}, 5000);
+
+app.get('/api/leds', (req, res) => {
+    res.writeHead(200, {
+        'Content-Type': 'text/event-stream',
+        'Cache-Control': 'no-cache',
+        Connection: 'keep-alive',
+    });
+
+    const snapshot = Object.fromEntries([...ledMirrors].filter(([, mirror]) => mirror.frame).map(([fqdn, mirror]) => [fqdn, mirror.frame]));
+    res.write(`event: snapshot\ndata: ${JSON.stringify(snapshot)}\n\n`);
+
+    ledPreviewClients.add(res);
+    syncLedMirrors();
+
+    req.on('close', () => {
+        ledPreviewClients.delete(res);
+        syncLedMirrors();
+    });
+});
+
+// Prometheus scrape endpoint
+app.get('/metrics', (_req, res) => {
+    res.type('text/plain; version=0.0.4').send(metrics.render());
+});
+
 app.get('/api/identify/:fqdn', async (req, res) => {
     const {fqdn} = req.params;
 
@@ -509,7 +1031,40 @@ app.get('/api/setBrightness/:fqdn/:brightness', async (req, res) => {
 
     serverConfig.lights[fqdn].brightness = brightnessValue;
 
-    await updateConfig();
+    await updateConfig(fqdn);
+
+    res.json({success: true});
+});
+
+// index -1 stops publishing the light over TSL UMD
+app.get('/api/setTslIndex/:fqdn/:index', async (req, res) => {
+    const {fqdn, index} = req.params;
+    const indexValue = parseInt(index, 10);
+
+    // 0xffff is the broadcast index
+    if (isNaN(indexValue) || indexValue < -1 || indexValue > 0xfffe) {
+        res.status(400).json({success: false, error: 'Index must be an integer between 0 and 65534, or -1'});
+        return;
+    }
+
+    const mapping = serverConfig.lights[fqdn];
+    if (!mapping) {
+        res.status(400).json({success: false, error: 'Light not configured'});
+        return;
+    }
+
+    if (mapping.tslIndex !== undefined && mapping.tslIndex !== indexValue) {
+        tslSender.clear(mapping.tslIndex);
+        tslSender.flush();
+    }
+
+    if (indexValue === -1) {
+        delete mapping.tslIndex;
+    } else {
+        mapping.tslIndex = indexValue;
+    }
+
+    await updateConfig(fqdn);
 
     res.json({success: true});
 });
@@ -524,8 +1079,9 @@ app.get('/api/add/:fqdn', async (req, res) => {
 
     serverConfig.lights[fqdn] = {brightness: 255, visibleInScenes: []};
     currentLightState[fqdn] = 'OFF';
+    tallyIndex.setLightScenes(fqdn, []);
 
-    await updateConfig();
+    await updateConfig(fqdn);
 
     res.json({success: true});
 });
@@ -538,10 +1094,26 @@ app.get('/api/remove/:fqdn', async (req, res) => {
         return;
     }
 
+    if (serverConfig.lights[fqdn].tslIndex !== undefined) {
+        tslSender.clear(serverConfig.lights[fqdn].tslIndex);
+        tslSender.flush();
+    }
+
+    // an empty retained message deletes the retained state, the light must not pick it up when it connects again
+    if (mqtt?.connected) {
+        mqtt.publish(mqttStateTopic(fqdn), '', {qos: 1, retain: true}).catch(error => {
+            console.warn(`Error clearing retained state of ${fqdn}:`, error instanceof Error ? error.message : error);
+        });
+    }
+
     delete serverConfig.lights[fqdn];
     delete currentLightState[fqdn];
+    tallyIndex.removeLight(fqdn);
+    forgetAckedState(fqdn);
+    delete lastSentAt[fqdn];
 
-    await updateConfig();
+    // nothing to send, the light is gone
+    await updateConfig(fqdn);
 
     res.json({success: true});
 });
@@ -550,7 +1122,15 @@ app.post('/api/updateScenes/:fqdn', async (req, res) => {
     const {scenes} = req.body;
     const {fqdn} = req.params;
 
-    if (!fqdn || !Array.isArray(scenes)) {
+    // a plain scene uuid refers to the first OBS instance
+    const defaultInstance = serverConfig.obsInstances[0]?.id ?? defaultConfig.obsInstances[0]!.id;
+    const refs: (SceneRef | null)[] | null = Array.isArray(scenes) ? scenes.map((scene: unknown) => {
+        if (typeof scene === 'string') return {instance: defaultInstance, sceneUuid: scene};
+        const ref = scene as Partial<SceneRef> | null;
+        return typeof ref?.instance === 'string' && typeof ref.sceneUuid === 'string' ? {instance: ref.instance, sceneUuid: ref.sceneUuid} : null;
+    }) : null;
+
+    if (!fqdn || !refs || refs.includes(null)) {
         res.status(400).json({success: false, error: 'Invalid request body'});
         return;
     }
@@ -560,9 +1140,10 @@ app.post('/api/updateScenes/:fqdn', async (req, res) => {
         return;
     }
 
-    serverConfig.lights[fqdn].visibleInScenes = scenes;
+    serverConfig.lights[fqdn].visibleInScenes = refs as SceneRef[];
+    tallyIndex.setLightScenes(fqdn, sceneKeysOf(serverConfig.lights[fqdn]));
 
-    await updateConfig();
+    await updateConfig(fqdn);
 
     res.json({success: true});
 });
@@ -578,8 +1159,26 @@ app.get('/api/restart/:fqdn', async (req, res) => {
     }
 });
 
-const allowedConfigGetter: (keyof ServerConfig)[] = ['apiKey', 'obsAddress', 'obsPassword'];
-const allowedConfigSetter: (keyof ServerConfig)[] = ['apiKey', 'obsAddress', 'obsPassword'];
+const allowedConfigGetter: (keyof ServerConfig)[] = ['apiKey', 'obsInstances', 'obsMergePolicy', 'mqttUrl', 'tslPort', 'tslOutputs', 'vmixAddress', 'atemAddress'];
+const allowedConfigSetter: (keyof ServerConfig)[] = ['apiKey', 'obsInstances', 'obsMergePolicy', 'mqttUrl', 'tslPort', 'tslOutputs', 'vmixAddress', 'atemAddress'];
+
+// scene refs of the other tally sources use these
+const reservedInstances = [tslInstance, vmixInstance, atemInstance];
+
+// null if value is not a valid list of OBS instances
+const parseObsInstances = (value: unknown): ObsInstanceConfig[] | null => {
+    if (!Array.isArray(value)) return null;
+
+    const instances: ObsInstanceConfig[] = [];
+    for (const entry of value) {
+        const {id, address, password = ''} = (entry ?? {}) as Partial<ObsInstanceConfig>;
+        // ids are part of the tally index keys, see sceneKey()
+        if (typeof id !== 'string' || !id || id.includes('/') || reservedInstances.includes(id) || instances.some(instance => instance.id === id)) return null;
+        if (typeof address !== 'string' || typeof password !== 'string') return null;
+        instances.push({id, address, password});
+    }
+    return instances;
+};
 
 app.get('/api/config', async (req, res) => {
     res.setHeader('Content-Disposition', 'attachment; filename="config.json"');
@@ -604,17 +1203,69 @@ app.post('/api/config/:key', async (req, res) => {
         return;
     }
 
-    if (typeof value !== 'string') {
-        res.status(400).json({success: false, error: 'Value must be a string'});
-        return;
+    if (key === 'obsInstances') {
+        const instances = parseObsInstances(value);
+        if (!instances) {
+            res.status(400).json({success: false, error: 'Value must be a list of {id, address, password} with unique ids'});
+            return;
+        }
+        serverConfig.obsInstances = instances;
+    } else if (key === 'obsMergePolicy') {
+        if (value !== 'any' && value !== 'priority') {
+            res.status(400).json({success: false, error: 'Value must be "any" or "priority"'});
+            return;
+        }
+        serverConfig.obsMergePolicy = value;
+    } else if (key === 'tslPort') {
+        if (!Number.isInteger(value) || value < 0 || value > 65535) {
+            res.status(400).json({success: false, error: 'Value must be a port number, 0 to disable'});
+            return;
+        }
+        serverConfig.tslPort = value;
+    } else if (key === 'tslOutputs') {
+        if (!Array.isArray(value) || !value.every(url => typeof url === 'string' && /^(udp|tcp):\/\/[^/:]+:\d+$/.test(url))) {
+            res.status(400).json({success: false, error: 'Value must be a list of udp://host:port or tcp://host:port'});
+            return;
+        }
+        serverConfig.tslOutputs = value;
+    } else {
+        if (typeof value !== 'string') {
+            res.status(400).json({success: false, error: 'Value must be a string'});
+            return;
+        }
+
+        (serverConfig as any)[key] = value;
     }
 
-    (serverConfig as any)[key] = value;
+    if (key === 'apiKey') {
+        // lights may have rejected the old key, resend to all of them
+        forgetAckedState();
+    }
 
     await updateConfig();
 
-    if (key === 'obsAddress' || key === 'obsPassword') {
-        await restartObsWebSocket();
+    if (key === 'obsInstances') {
+        await syncObsInstances();
+    }
+
+    if (key === 'mqttUrl') {
+        restartMqtt();
+    }
+
+    if (key === 'tslPort') {
+        restartTsl();
+    }
+
+    if (key === 'tslOutputs') {
+        restartTslOutput();
+    }
+
+    if (key === 'vmixAddress') {
+        restartVmix();
+    }
+
+    if (key === 'atemAddress') {
+        restartAtem();
     }
 
     res.json({success: true});
@@ -638,143 +1289,231 @@ app.listen(PORT, HOST, () => {
     console.log(`Server is running at http://${HOST}:${PORT}`);
 });
 
-export const handleUpdate = async () => {
-    const updateCurrentState = async () => {
-        if (!obsConnected) {
-            console.warn('Not connected to OBS, skipping state update');
-            return;
-        }
+// what each light last accepted from us, an update only sends to lights whose computed state differs
+interface AckedLightState {
+    state: TallyLightState;
+    brightness: number;
+}
 
-        try {
-            const currentProgram = await obs.call('GetCurrentProgramScene');
-            currentState.programSceneUuid = currentProgram.currentProgramSceneUuid;
+const lastAckedState: Record<FQDN, AckedLightState> = {};
+const lastSentAt: Record<FQDN, number> = {};
+const fanOutStats = {sent: 0, skipped: 0, reconciled: 0};
 
-            const currentPreview = await obs.call('GetCurrentPreviewScene');
-            currentState.previewSceneUuid = currentPreview.currentPreviewSceneUuid;
+// every light gets its state re-sent about this often, to catch lights that drifted (rebooted, missed a packet)
+const reconcileIntervalMs = 15000;
+const reconcileTickMs = 1000;
 
-            console.log('Updated program scene:', currentState.programSceneUuid, currentProgram.currentProgramSceneName);
-            console.log('Updated preview scene:', currentState.previewSceneUuid, currentPreview.currentPreviewSceneName);
-        } catch (error) {
-            console.error('Error fetching scenes from OBS:', error);
-        }
-    };
+export const forgetAckedState = (tallyLightFqdn?: FQDN) => {
+    if (tallyLightFqdn) {
+        delete lastAckedState[tallyLightFqdn];
+        return;
+    }
+    for (const fqdn of Object.keys(lastAckedState)) {
+        delete lastAckedState[fqdn];
+    }
+};
 
-    await updateCurrentState();
+const determineState = (fqdn: string) => {
+    if (!serverConfig.lights[fqdn]) {
+        console.warn(`No mapping found for ${fqdn}, skipping`);
+        return;
+    }
 
-    const determineState = (fqdn: string) => {
-        try {
-            const mapping = serverConfig.lights[fqdn];
-            if (!mapping) {
-                console.warn(`No mapping found for ${fqdn}, skipping`);
-                return;
-            }
+    currentLightState[fqdn] = tallyIndex.stateOf(fqdn, computedFor);
+};
 
-            if (!currentState.programSceneUuid && !currentState.previewSceneUuid) {
-                currentLightState[fqdn] = 'ERROR';
-                return;
-            }
+// at most one send per light is in flight; a light that gets a new state meanwhile is sent to again afterwards
+// with whatever is current then, so a slow light never ends up with an older state than a fast one
+const sendsInFlight = new Set<FQDN>();
+const sendsPending = new Map<FQDN, boolean>(); // fqdn -> force
 
-            if (currentState.programSceneUuid && mapping.visibleInScenes.includes(currentState.programSceneUuid)) {
-                currentLightState[fqdn] = 'PROGRAM';
-            } else if (currentState.previewSceneUuid && mapping.visibleInScenes.includes(currentState.previewSceneUuid)) {
-                currentLightState[fqdn] = 'PREVIEW';
-            } else if (mapping.visibleInScenes.length > 0) {
-                currentLightState[fqdn] = 'STANDBY';
-            } else {
-                currentLightState[fqdn] = 'OFF';
-            }
-        } catch (error) {
-            console.error(`Error determining state for light ${fqdn}:`, error);
+const updateState = async (fqdn: string, force = false): Promise<void> => {
+    if (sendsInFlight.has(fqdn)) {
+        sendsPending.set(fqdn, force || (sendsPending.get(fqdn) ?? false));
+        return;
+    }
+
+    sendsInFlight.add(fqdn);
+    try {
+        await sendState(fqdn, force);
+    } finally {
+        sendsInFlight.delete(fqdn);
+    }
+
+    const pendingForce = sendsPending.get(fqdn);
+    if (pendingForce !== undefined) {
+        sendsPending.delete(fqdn);
+        await updateState(fqdn, pendingForce);
+    }
+};
+
+const sendState = async (fqdn: string, force: boolean) => {
+    try {
+        const state = currentLightState[fqdn];
+
+        if (!state) {
+            console.warn(`No current state for ${fqdn}, skipping`);
             return;
         }
-    };
 
-    const updateState = async (fqdn: string) => {
-        try {
-            const state = currentLightState[fqdn];
+        const brightness = serverConfig.lights[fqdn]?.brightness || 255;
+        const acked = lastAckedState[fqdn];
+        if (!force && acked && acked.state === state && acked.brightness === brightness) {
+            fanOutStats.skipped++;
+            return;
+        }
 
-            if (!state) {
-                console.warn(`No current state for ${fqdn}, skipping`);
-                return;
+        fanOutStats.sent++;
+        lastSentAt[fqdn] = Date.now();
+        const observeSet = lightSetSeconds.startTimer({protocol: selectProtocol(fqdn)});
+        const result = await setTallyLightState(fqdn, state);
+        observeSet({result: result.success ? 'ok' : result.error instanceof TallyLightOfflineError ? 'offline' : 'error'});
+        if (result.success) {
+            if (pendingEventAt !== null) {
+                const elapsed = performance.now() - pendingEventAt;
+                eventToFirstLight.record(elapsed);
+                eventToFirstLightSeconds.observe(elapsed / 1000, {source: pendingEventSource});
+                pendingEventAt = null;
             }
-
-            const result = await setTallyLightState(fqdn, state);
-            if (!result.success) {
-                if (!(result.error instanceof TallyLightOfflineError)) {
-                    console.error(`Failed to set state for ${fqdn}:`, result.error);
-                }
+            // the light may report another state if a higher priority source is active, what counts is that it
+            // has ours
+            lastAckedState[fqdn] = {state, brightness};
+        } else {
+            delete lastAckedState[fqdn];
+            if (!(result.error instanceof TallyLightOfflineError)) {
+                console.error(`Failed to set state for ${fqdn}:`, result.error);
             }
-        } catch (error) {
-            console.error(`Error processing light ${fqdn}:`, error);
         }
-    };
-
-    let promises: Promise<void>[] = [];
+    } catch (error) {
+        console.error(`Error processing light ${fqdn}:`, error);
+    }
+};
 
-    executeForEachLight(async (fqdn) => {
-        promises.push((async () => {
-            determineState(fqdn);
-            await updateState(fqdn);
-        })());
-    });
+// What the next update has to look at: every light, or only the lights in scenes that program/preview left or
+// entered since the last update plus the lights whose config changed.
+let fullUpdateDue = true;
+const dirtyLights = new Set<FQDN>();
+let computedFor: LiveScenes = liveScenesOf({programSceneUuid: null, previewSceneUuid: null});
+
+// The live scenes of the instances that count under the merge policy. While no instance is connected, the last
+// known state of all of them is kept, so a reconnecting OBS does not turn every light to ERROR.
+const mergedLiveScenes = async (): Promise<LiveScenes> => {
+    const instances = [...obsInstances.values()];
+    const connected = instances.filter(instance => instance.connected);
+    const candidates = connected.length > 0 ? connected : instances;
+    const merged = serverConfig.obsMergePolicy === 'priority' ? candidates.slice(0, 1) : candidates;
+
+    // served from the scene graph caches unless a scene changed since
+    const lives = await Promise.all(merged.map(instance => instance.liveScenes()));
+    // hardware switchers and vMix are other sources, not backups, so they always count
+    if (serverConfig.tslPort) {
+        lives.push(tslReceiver.liveScenes());
+    }
+    if (serverConfig.vmixAddress) {
+        lives.push(vmixClient.liveScenes());
+    }
+    if (serverConfig.atemAddress) {
+        lives.push(atemClient.liveScenes());
+    }
+    if (lives.length === 1) return lives[0]!;
 
-    await Promise.all(promises).catch(error => {
-        console.error('Error updating lights:', error);
-    });
+    const program = new Set<string>();
+    const preview = new Set<string>();
+    for (const live of lives) {
+        live.program.forEach(scene => program.add(scene));
+        live.preview.forEach(scene => preview.add(scene));
+    }
+    return {program, preview};
 };
 
-obs.on('ConnectionOpened', async () => {
-    obsConnected = true;
-    console.log('Connected to OBS successfully');
-});
+export const handleUpdate = async () => {
+    if (pendingUpdateEvent) {
+        eventToUpdateSeconds.observe((performance.now() - pendingUpdateEvent.at) / 1000, {source: pendingUpdateEvent.source});
+        pendingUpdateEvent = null;
+    }
+    const eventAt = pendingEventAt;
+    const observeUpdate = updateSeconds.startTimer({kind: fullUpdateDue ? 'full' : 'incremental'});
+
+    // scene keys are per instance, so a change in one instance only affects the lights mapped to its scenes
+    const target = await mergedLiveScenes();
+    const affected = fullUpdateDue ? null : tallyIndex.affectedLights(computedFor, target);
+    const lights = affected ? new Set([...affected, ...dirtyLights]) : Object.keys(serverConfig.lights);
+
+    fullUpdateDue = false;
+    dirtyLights.clear();
+    computedFor = target;
+
+    // not awaited: a light that times out must not hold back the next run
+    let changed = false;
+    for (const fqdn of lights) {
+        if (!serverConfig.lights[fqdn]) continue;
+        determineState(fqdn);
+        if (lastAckedState[fqdn]?.state !== currentLightState[fqdn]) changed = true;
+        updateState(fqdn).catch(error => {
+            console.error(`Error updating light ${fqdn}:`, error);
+        });
 
-obs.on('ConnectionClosed', () => {
-    obsConnected = false;
-    console.warn('Connection to OBS closed, attempting to reconnect in 5 seconds...');
-    setTimeout(async () => {
-        try {
-            await obs.connect(serverConfig.obsAddress, serverConfig.obsPassword);
-            console.log('Reconnected to OBS successfully');
-        } catch (error) {
-            console.error('Failed to reconnect to OBS:', error);
+        const tslIndex = serverConfig.lights[fqdn].tslIndex;
+        if (tslIndex !== undefined) {
+            // labelled with the light's hostname
+            tslSender.set(tslIndex, tslTallyOf(currentLightState[fqdn]!), fqdn.split('.')[0]!);
         }
-    }, 5000);
-});
+    }
+    // all displays that changed in this run go out together
+    tslSender.flush();
+    // the event changed no light, so the next unrelated send must not be timed against it
+    if (!changed && pendingEventAt === eventAt) pendingEventAt = null;
+    observeUpdate();
+    scheduleUiPush();
+};
 
-obs.on('ConnectionError', (error) => {
-    obsConnected = false;
-    console.error('OBS WebSocket error:', error);
-});
+// every trigger goes through here, so a burst of OBS events causes one fan-out
+const updateScheduler = new CoalescingScheduler(handleUpdate);
 
-// we cannot use the data from the event because it is not in sync with preview/program
-obs.on('CurrentProgramSceneChanged', async () => {
-    await handleUpdate();
-});
+export const scheduleUpdate = () => {
+    fullUpdateDue = true;
+    return updateScheduler.request();
+};
 
-obs.on('CurrentPreviewSceneChanged', async () => {
-    await handleUpdate();
-});
+// program/preview changed, only lights in the affected scenes are recomputed
+export const scheduleSceneUpdate = () => updateScheduler.request();
 
-try {
-    await obs.connect(serverConfig.obsAddress, serverConfig.obsPassword);
+export const scheduleLightUpdate = (tallyLightFqdn: FQDN) => {
+    dirtyLights.add(tallyLightFqdn);
+    return updateScheduler.request();
+};
 
-    try {
-        const currentProgram = await obs.call('GetCurrentProgramScene');
-        currentState.programSceneUuid = currentProgram.currentProgramSceneUuid;
+// Staggered reconciliation: each tick re-sends to the few lights that were sent to longest ago, so all lights are
+// refreshed once per reconcileIntervalMs without a burst every interval.
+const reconcileLights = async () => {
+    const fqdns = Object.keys(serverConfig.lights);
+    const perTick = Math.ceil(fqdns.length * reconcileTickMs / reconcileIntervalMs);
+    const now = Date.now();
 
-        const currentPreview = await obs.call('GetCurrentPreviewScene');
-        currentState.previewSceneUuid = currentPreview.currentPreviewSceneUuid;
+    const due = fqdns
+        .filter(fqdn => now - (lastSentAt[fqdn] ?? 0) >= reconcileIntervalMs)
+        .sort((a, b) => (lastSentAt[a] ?? 0) - (lastSentAt[b] ?? 0))
+        .slice(0, perTick);
 
-        console.log('Initial program scene:', currentState.programSceneUuid, currentProgram.currentProgramSceneName);
-        console.log('Initial preview scene:', currentState.previewSceneUuid, currentPreview.currentPreviewSceneName);
+    fanOutStats.reconciled += due.length;
+    await Promise.all(due.map(fqdn => updateState(fqdn, true)));
+};
 
-        await handleUpdate();
-    } catch (error) {
-        console.error('Error fetching initial scenes from OBS:', error);
+const onObsChange = (instance: ObsInstance, change: ObsChange) => {
+    if (change === 'sceneList') {
+        // names and order only, no light changes state
+        scheduleUiPush();
+        return;
     }
-} catch (error) {
-    console.error('Failed to connect to OBS:', error);
-}
+    if (change === 'event') {
+        noteTallyEvent('obs');
+    }
+    scheduleSceneUpdate().catch(error => {
+        console.error(`Error updating lights after OBS ${instance.id} ${change}:`, error);
+    });
+};
+
+await syncObsInstances();
 
 setInterval(async () => {
     executeForEachLight(async (fqdn) => {
@@ -783,6 +1522,16 @@ setInterval(async () => {
     });
 }, 10000);
 
+restartMqtt();
+
+restartTsl();
+
+restartTslOutput();
+
+restartVmix();
+
+restartAtem();
+
 restartServiceBrowser();
 
 // restart service browser every minute to avoid potential issues
@@ -796,16 +1545,28 @@ setInterval(() => {
     }
 }, 60000);
 
-// send update every 15 seconds in case of missed events
+// re-query OBS every 15 seconds in case of missed events
 setInterval(async () => {
-    await handleUpdate();
+    await Promise.all([...obsInstances.values()].map(instance => instance.reconcile()));
 }, 15000);
 
+setInterval(async () => {
+    await reconcileLights();
+}, reconcileTickMs);
+
 process.on('SIGINT', async () => {
     console.log('Shutting down...');
     instanceBrowser?.stop();
     instance?.destroy();
-    await obs.disconnect();
+    mqtt?.stop();
+    frameClient.close();
+    tslReceiver.stop();
+    tslSender.stop();
+    vmixClient.stop();
+    atemClient.stop();
+    ledMirrors.forEach(mirror => mirror.stop());
+    await Promise.all([...obsInstances.values()].map(instance => instance.stop()));
+    await configWriter.flush();
     process.exit(0);
 });
 
@@ -813,7 +1574,15 @@ process.on('SIGTERM', async () => {
     console.log('Shutting down...');
     instanceBrowser?.stop();
     instance?.destroy();
-    await obs.disconnect();
+    mqtt?.stop();
+    frameClient.close();
+    tslReceiver.stop();
+    tslSender.stop();
+    vmixClient.stop();
+    atemClient.stop();
+    ledMirrors.forEach(mirror => mirror.stop());
+    await Promise.all([...obsInstances.values()].map(instance => instance.stop()));
+    await configWriter.flush();
     process.exit(0);
 });
 
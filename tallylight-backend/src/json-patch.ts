@@ -0,0 +1,38 @@
+// JSON merge patches (RFC 7386) between two versions of a document, so the UI only receives what changed.
+// Objects are compared key by key, anything else (arrays too) is replaced as a whole. A removed key is null in the
+// patch; a value that became null therefore reads as removed, which the UI treats the same.
+export type Json = null | boolean | number | string | Json[] | { [key: string]: Json };
+
+type JsonObject = { [key: string]: Json };
+
+const isObject = (value: Json | undefined): value is JsonObject =>
+    typeof value === 'object' && value !== null && !Array.isArray(value);
+
+const sameJson = (a: Json | undefined, b: Json | undefined): boolean => {
+    if (a === b) return true;
+    if (Array.isArray(a) && Array.isArray(b)) {
+        return a.length === b.length && a.every((value, i) => sameJson(value, b[i]));
+    }
+    if (isObject(a) && isObject(b)) {
+        const keys = Object.keys(a);
+        return keys.length === Object.keys(b).length && keys.every(key => key in b && sameJson(a[key], b[key]));
+    }
+    return false;
+};
+
+// the patch that turns previous into next, undefined if they are equal
+export const mergePatch = (previous: Json | undefined, next: Json): Json | undefined => {
+    if (!isObject(previous) || !isObject(next)) {
+        return sameJson(previous, next) ? undefined : next;
+    }
+
+    let patch: JsonObject | undefined;
+    for (const key of Object.keys(previous)) {
+        if (!(key in next)) (patch ??= {})[key] = null;
+    }
+    for (const [key, value] of Object.entries(next)) {
+        const change = mergePatch(previous[key], value);
+        if (change !== undefined) (patch ??= {})[key] = change;
+    }
+    return patch;
+};
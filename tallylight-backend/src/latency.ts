@@ -0,0 +1,44 @@
+// Latency samples in a fixed ring, enough for percentiles over the recent past without growing.
+export interface LatencyStats {
+    samples: number;
+    lastMs: number;
+    avgMs: number;
+    p50Ms: number;
+    p95Ms: number;
+    maxMs: number;
+}
+
+export class LatencyRecorder {
+    private readonly ring: number[] = [];
+    private next = 0;
+    private count = 0;
+    private last = 0;
+
+    constructor(private readonly size = 256) {
+    }
+
+    record(ms: number) {
+        if (this.ring.length < this.size) {
+            this.ring.push(ms);
+        } else {
+            this.ring[this.next] = ms;
+        }
+        this.next = (this.next + 1) % this.size;
+        this.count++;
+        this.last = ms;
+    }
+
+    get stats(): LatencyStats {
+        const sorted = [...this.ring].sort((a, b) => a - b);
+        const percentile = (p: number) => sorted.length ? sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))]! : 0;
+
+        return {
+            samples: this.count,
+            lastMs: this.last,
+            avgMs: sorted.length ? sorted.reduce((sum, value) => sum + value, 0) / sorted.length : 0,
+            p50Ms: percentile(0.5),
+            p95Ms: percentile(0.95),
+            maxMs: sorted.length ? sorted[sorted.length - 1]! : 0,
+        };
+    }
+}
@@ -0,0 +1,150 @@
+// Minimal Prometheus metrics in the text exposition format (version 0.0.4): counters, gauges and histograms with
+// labels. Counters and gauges can also be computed at scrape time from a callback.
+export type Labels = Record<string, string>;
+
+// seconds, from a fast local UDP send to an HTTP request running into its 3 s timeout
+export const defaultBuckets = [0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5];
+
+const escapeLabelValue = (value: string) => value.replace(/\\/g, '\\\\').replace(/\n/g, '\\n').replace(/"/g, '\\"');
+
+const formatLabels = (labels: Labels, extra?: [string, string]) => {
+    const entries = Object.entries(labels);
+    if (extra) entries.push(extra);
+    return entries.length > 0 ? `{${entries.map(([name, value]) => `${name}="${escapeLabelValue(value)}"`).join(',')}}` : '';
+};
+
+const formatValue = (value: number) => Number.isFinite(value) ? String(value) : value > 0 ? '+Inf' : value < 0 ? '-Inf' : 'NaN';
+
+// label sets are keyed by their serialized form, callers pass the labels in a consistent order
+const seriesKey = (labels: Labels) => JSON.stringify(labels);
+
+interface Metric {
+    render(): string;
+}
+
+// computes the series at scrape time, for values the backend already keeps
+export type Collector = () => number | [Labels, number][];
+
+type Series = Map<string, { labels: Labels; value: number }>;
+
+const renderSeries = (name: string, help: string, type: string, series: Series, collect?: Collector) => {
+    const lines = [`# HELP ${name} ${help}`, `# TYPE ${name} ${type}`];
+    const collected = collect?.();
+    const values: [Labels, number][] = typeof collected === 'number' ? [[{}, collected]]
+        : collected ?? [...series.values()].map(({labels, value}) => [labels, value]);
+    for (const [labels, value] of values) {
+        lines.push(`${name}${formatLabels(labels)} ${formatValue(value)}`);
+    }
+    return lines.join('\n');
+};
+
+export class Counter implements Metric {
+    private readonly series: Series = new Map();
+
+    constructor(readonly name: string, private readonly help: string, private readonly collect?: Collector) {
+    }
+
+    inc(labels: Labels = {}, value = 1) {
+        const key = seriesKey(labels);
+        const series = this.series.get(key);
+        if (series) {
+            series.value += value;
+        } else {
+            this.series.set(key, {labels, value});
+        }
+    }
+
+    render() {
+        return renderSeries(this.name, this.help, 'counter', this.series, this.collect);
+    }
+}
+
+export class Gauge implements Metric {
+    private readonly series: Series = new Map();
+
+    constructor(readonly name: string, private readonly help: string, private readonly collect?: Collector) {
+    }
+
+    set(value: number, labels: Labels = {}) {
+        this.series.set(seriesKey(labels), {labels, value});
+    }
+
+    render() {
+        return renderSeries(this.name, this.help, 'gauge', this.series, this.collect);
+    }
+}
+
+interface HistogramSeries {
+    labels: Labels;
+    counts: number[]; // per bucket, not cumulative; rendered cumulative
+    sum: number;
+    count: number;
+}
+
+export class Histogram implements Metric {
+    private readonly series = new Map<string, HistogramSeries>();
+
+    constructor(readonly name: string, private readonly help: string, private readonly buckets = defaultBuckets) {
+    }
+
+    observe(value: number, labels: Labels = {}) {
+        const key = seriesKey(labels);
+        let series = this.series.get(key);
+        if (!series) {
+            series = {labels, counts: new Array(this.buckets.length + 1).fill(0), sum: 0, count: 0};
+            this.series.set(key, series);
+        }
+
+        let bucket = this.buckets.findIndex(bound => value <= bound);
+        if (bucket < 0) bucket = this.buckets.length;
+        series.counts[bucket]!++;
+        series.sum += value;
+        series.count++;
+    }
+
+    // returns a function that observes the seconds since the timer was started
+    startTimer(labels: Labels = {}) {
+        const start = performance.now();
+        return (extraLabels?: Labels) => this.observe((performance.now() - start) / 1000, extraLabels ? {...labels, ...extraLabels} : labels);
+    }
+
+    render() {
+        const lines = [`# HELP ${this.name} ${this.help}`, `# TYPE ${this.name} histogram`];
+        for (const {labels, counts, sum, count} of this.series.values()) {
+            let cumulative = 0;
+            this.buckets.forEach((bound, i) => {
+                cumulative += counts[i]!;
+                lines.push(`${this.name}_bucket${formatLabels(labels, ['le', formatValue(bound)])} ${cumulative}`);
+            });
+            lines.push(`${this.name}_bucket${formatLabels(labels, ['le', '+Inf'])} ${count}`);
+            lines.push(`${this.name}_sum${formatLabels(labels)} ${formatValue(sum)}`);
+            lines.push(`${this.name}_count${formatLabels(labels)} ${count}`);
+        }
+        return lines.join('\n');
+    }
+}
+
+export class MetricsRegistry {
+    private readonly metrics: Metric[] = [];
+
+    counter(name: string, help: string, collect?: Collector) {
+        return this.add(new Counter(name, help, collect));
+    }
+
+    gauge(name: string, help: string, collect?: Collector) {
+        return this.add(new Gauge(name, help, collect));
+    }
+
+    histogram(name: string, help: string, buckets?: number[]) {
+        return this.add(new Histogram(name, help, buckets));
+    }
+
+    render() {
+        return this.metrics.map(metric => metric.render()).join('\n') + '\n';
+    }
+
+    private add<T extends Metric>(metric: T): T {
+        this.metrics.push(metric);
+        return metric;
+    }
+}
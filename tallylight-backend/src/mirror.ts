@@ -0,0 +1,120 @@
+// Client for the firmware's live LED mirror at /leds (server-sent events, see mirrorLeds() in main.cpp).
+// Keeps the last known frame of one light and reports every change as the delta the light sent.
+
+export interface LedFrame {
+    brightness: number;
+    leds: string[]; // RRGGBB
+}
+
+export interface LedDelta {
+    brightness: number;
+    changed: [number, string][];
+}
+
+interface FrameEvent {
+    b: number;
+    leds: string;
+}
+
+interface DeltaEvent {
+    b: number;
+    d: [number, string][];
+}
+
+export class LedMirror {
+    frame: LedFrame | null = null;
+
+    private abortController: AbortController | null = null;
+    private reconnectTimer: NodeJS.Timeout | null = null;
+    private stopped = true;
+
+    constructor(
+        private readonly url: string,
+        private readonly onFrame: (frame: LedFrame) => void,
+        private readonly onDelta: (delta: LedDelta) => void,
+    ) {
+    }
+
+    start() {
+        if (!this.stopped) return;
+        this.stopped = false;
+        void this.connect();
+    }
+
+    stop() {
+        this.stopped = true;
+        if (this.reconnectTimer) clearTimeout(this.reconnectTimer);
+        this.abortController?.abort();
+        this.abortController = null;
+        this.frame = null;
+    }
+
+    private async connect() {
+        const abortController = new AbortController();
+        this.abortController = abortController;
+
+        try {
+            const response = await fetch(this.url, {
+                signal: abortController.signal,
+                headers: {Accept: 'text/event-stream'},
+            });
+            if (!response.ok || !response.body) {
+                throw new Error(response.statusText);
+            }
+
+            const decoder = new TextDecoder();
+            let buffer = '';
+            for await (const chunk of response.body) {
+                buffer += decoder.decode(chunk, {stream: true});
+
+                // events are separated by an empty line
+                let end: number;
+                while ((end = buffer.indexOf('\n\n')) >= 0) {
+                    this.onEvent(buffer.slice(0, end));
+                    buffer = buffer.slice(end + 2);
+                }
+            }
+        } catch (error) {
+            if (error instanceof Error && error.name !== 'AbortError') {
+                console.warn(`LED mirror ${this.url} failed:`, error.message);
+            }
+        }
+
+        if (this.abortController === abortController) {
+            this.frame = null;
+            if (!this.stopped) {
+                this.reconnectTimer = setTimeout(() => this.connect(), 3000);
+            }
+        }
+    }
+
+    private onEvent(raw: string) {
+        let event = 'message';
+        let data = '';
+        for (const line of raw.split(/\r?\n/)) {
+            if (line.startsWith('event:')) {
+                event = line.slice(6).trim();
+            } else if (line.startsWith('data:')) {
+                data += line.slice(5).trim();
+            }
+        }
+        if (!data) return;
+
+        try {
+            if (event === 'frame') {
+                const {b, leds} = JSON.parse(data) as FrameEvent;
+                this.frame = {brightness: b, leds: leds.match(/.{6}/g) ?? []};
+                this.onFrame(this.frame);
+            } else if (event === 'delta' && this.frame) {
+                const {b, d} = JSON.parse(data) as DeltaEvent;
+                this.frame.brightness = b;
+                for (const [index, color] of d) {
+                    this.frame.leds[index] = color;
+                }
+                this.onDelta({brightness: b, changed: d});
+            }
+        } catch (error) {
+            console.warn(`Invalid LED mirror event from ${this.url}:`, data);
+        }
+    }
+}
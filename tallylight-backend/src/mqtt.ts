@@ -0,0 +1,236 @@
+import net from 'net';
+
+// Minimal MQTT 3.1.1 publisher. We only ever publish (retained) state, so this implements
+// CONNECT, PUBLISH (QoS 0/1), PUBACK, PINGREQ and DISCONNECT and nothing else.
+
+export interface MqttPublishOptions {
+    qos?: 0 | 1;
+    retain?: boolean;
+}
+
+interface PendingPublish {
+    resolve: () => void;
+    reject: (error: Error) => void;
+    timeout: NodeJS.Timeout;
+}
+
+const encodeLength = (length: number): Buffer => {
+    const bytes: number[] = [];
+    do {
+        let byte = length % 128;
+        length = Math.floor(length / 128);
+        if (length > 0) byte |= 0x80;
+        bytes.push(byte);
+    } while (length > 0);
+    return Buffer.from(bytes);
+};
+
+const encodeString = (value: string | Buffer): Buffer => {
+    const data = typeof value === 'string' ? Buffer.from(value, 'utf-8') : value;
+    const length = Buffer.alloc(2);
+    length.writeUInt16BE(data.length);
+    return Buffer.concat([length, data]);
+};
+
+const packet = (header: number, ...parts: Buffer[]): Buffer => {
+    const body = Buffer.concat(parts);
+    return Buffer.concat([Buffer.from([header]), encodeLength(body.length), body]);
+};
+
+export class MqttPublisher {
+    private socket: net.Socket | null = null;
+    private buffer = Buffer.alloc(0);
+    private nextPacketId = 1;
+    private pending = new Map<number, PendingPublish>();
+    private keepAliveTimer: NodeJS.Timeout | null = null;
+    private reconnectTimer: NodeJS.Timeout | null = null;
+    private stopped = false;
+
+    connected = false;
+
+    constructor(
+        private readonly url: string,
+        private readonly clientId: string,
+        private readonly keepAliveSeconds = 30,
+    ) {
+    }
+
+    start() {
+        this.stopped = false;
+        this.connect();
+    }
+
+    stop() {
+        this.stopped = true;
+        if (this.reconnectTimer) clearTimeout(this.reconnectTimer);
+        if (this.socket && this.connected) {
+            this.socket.end(Buffer.from([0xE0, 0x00]));
+        } else {
+            this.socket?.destroy();
+        }
+        this.cleanup(new Error('MQTT publisher stopped'));
+    }
+
+    publish(topic: string, payload: string | Buffer, {qos = 0, retain = false}: MqttPublishOptions = {}): Promise<void> {
+        if (!this.socket || !this.connected) {
+            return Promise.reject(new Error('MQTT not connected'));
+        }
+
+        const flags = 0x30 | (qos << 1) | (retain ? 0x01 : 0x00);
+        const data = typeof payload === 'string' ? Buffer.from(payload, 'utf-8') : payload;
+
+        if (qos === 0) {
+            this.socket.write(packet(flags, encodeString(topic), data));
+            return Promise.resolve();
+        }
+
+        const packetId = this.nextPacketId;
+        this.nextPacketId = this.nextPacketId === 0xFFFF ? 1 : this.nextPacketId + 1;
+
+        const id = Buffer.alloc(2);
+        id.writeUInt16BE(packetId);
+
+        return new Promise((resolve, reject) => {
+            const timeout = setTimeout(() => {
+                this.pending.delete(packetId);
+                reject(new Error(`PUBACK timeout for ${topic}`));
+            }, 3000);
+            this.pending.set(packetId, {resolve, reject, timeout});
+            this.socket?.write(packet(flags, encodeString(topic), id, data));
+        });
+    }
+
+    private connect() {
+        let host = 'localhost';
+        let port = 1883;
+        let username = '';
+        let password = '';
+
+        try {
+            const parsed = new URL(this.url);
+            host = parsed.hostname || host;
+            port = parsed.port ? parseInt(parsed.port, 10) : port;
+            username = decodeURIComponent(parsed.username);
+            password = decodeURIComponent(parsed.password);
+        } catch (error) {
+            console.error('Invalid MQTT URL:', this.url);
+            return;
+        }
+
+        const socket = net.createConnection({host, port});
+        this.socket = socket;
+        this.buffer = Buffer.alloc(0);
+
+        socket.setNoDelay(true);
+
+        socket.on('connect', () => {
+            let connectFlags = 0x02; // clean session
+            const payload = [encodeString(this.clientId)];
+            if (username) {
+                connectFlags |= 0x80;
+                payload.push(encodeString(username));
+            }
+            if (password) {
+                connectFlags |= 0x40;
+                payload.push(encodeString(password));
+            }
+
+            const keepAlive = Buffer.alloc(2);
+            keepAlive.writeUInt16BE(this.keepAliveSeconds);
+
+            socket.write(packet(0x10, encodeString('MQTT'), Buffer.from([0x04, connectFlags]), keepAlive, ...payload));
+        });
+
+        socket.on('data', (chunk) => this.onData(chunk));
+
+        socket.on('error', (error) => {
+            console.warn('MQTT connection error:', error.message);
+        });
+
+        socket.on('close', () => {
+            if (this.socket !== socket) return;
+
+            if (this.connected) {
+                console.warn('MQTT connection closed');
+            }
+            this.cleanup(new Error('MQTT connection closed'));
+            this.socket = null;
+
+            if (!this.stopped) {
+                this.reconnectTimer = setTimeout(() => this.connect(), 5000);
+            }
+        });
+    }
+
+    private cleanup(error: Error) {
+        this.connected = false;
+        if (this.keepAliveTimer) {
+            clearInterval(this.keepAliveTimer);
+            this.keepAliveTimer = null;
+        }
+        for (const {reject, timeout} of this.pending.values()) {
+            clearTimeout(timeout);
+            reject(error);
+        }
+        this.pending.clear();
+    }
+
+    private onData(chunk: Buffer) {
+        this.buffer = Buffer.concat([this.buffer, chunk]);
+
+        while (this.buffer.length >= 2) {
+            // decode remaining length
+            let multiplier = 1;
+            let length = 0;
+            let offset = 1;
+            let byte: number;
+            do {
+                if (offset >= this.buffer.length) return; // incomplete
+                byte = this.buffer[offset++]!;
+                length += (byte & 0x7F) * multiplier;
+                multiplier *= 128;
+            } while (byte & 0x80);
+
+            if (this.buffer.length < offset + length) return; // incomplete
+
+            const type = this.buffer[0]! >> 4;
+            const body = this.buffer.subarray(offset, offset + length);
+            this.buffer = this.buffer.subarray(offset + length);
+
+            this.onPacket(type, body);
+        }
+    }
+
+    private onPacket(type: number, body: Buffer) {
+        switch (type) {
+            case 2: { // CONNACK
+                const returnCode = body[1];
+                if (returnCode !== 0) {
+                    console.error('MQTT broker refused connection, return code', returnCode);
+                    this.socket?.destroy();
+                    return;
+                }
+                this.connected = true;
+                console.log('Connected to MQTT broker', this.url);
+                this.keepAliveTimer = setInterval(() => {
+                    this.socket?.write(Buffer.from([0xC0, 0x00]));
+                }, this.keepAliveSeconds * 500);
+                break;
+            }
+            case 4: { // PUBACK
+                const packetId = body.readUInt16BE(0);
+                const pending = this.pending.get(packetId);
+                if (pending) {
+                    clearTimeout(pending.timeout);
+                    this.pending.delete(packetId);
+                    pending.resolve();
+                }
+                break;
+            }
+            case 13: // PINGRESP
+                break;
+            default:
+                console.warn('Unexpected MQTT packet type', type);
+        }
+    }
+}
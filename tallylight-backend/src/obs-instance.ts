@@ -0,0 +1,268 @@
+import {OBSWebSocket} from 'obs-websocket-js';
+import {SceneModel} from './scene-model.js';
+import {SceneGraph} from './scene-graph.js';
+import {type LiveScenes, sceneKey} from './tally-index.js';
+import type {SceneUuid} from './types.js';
+
+export interface ObsInstanceConfig {
+    id: string; // referenced by the lights' scene mappings, so it must stay the same when the address changes
+    address: string;
+    password: string;
+}
+
+// why an instance's program/preview may have changed, or 'sceneList' if only the scene list did
+export type ObsChange = 'event' | 'graph' | 'connection' | 'reconcile' | 'sceneList';
+
+// the scene list is kept from events, a refetch now and then corrects it should one have been missed
+const sceneListValidateMs = 30000;
+
+type ObsScene = { sceneUuid: string; sceneName: string; sceneIndex: number; instance: string };
+
+export type ObsChangeListener = (instance: ObsInstance, change: ObsChange) => void;
+
+// One OBS connection with its own scene model, scene graph and reconnect handling.
+export class ObsInstance {
+    readonly obs = new OBSWebSocket();
+    // program/preview as last reported by this OBS, see SceneModel
+    readonly model = new SceneModel();
+    // which scenes and groups are nested (visible) in which, so a light mapped to a nested scene lights up too
+    readonly graph: SceneGraph;
+    connected = false;
+
+    private stopped = false;
+    private reconnectTimer: NodeJS.Timeout | null = null;
+    private validateTimer: NodeJS.Timeout | null = null;
+    // GetSceneList as last fetched, kept up to date by the scene events so the UI never has to ask OBS
+    private scenes: ObsScene[] = [];
+    // closures are cached by the graph, qualifying each only once keeps the sets identical between updates
+    private readonly qualified = new WeakMap<ReadonlySet<SceneUuid>, ReadonlySet<string>>();
+
+    constructor(readonly config: ObsInstanceConfig, private readonly onChange: ObsChangeListener) {
+        this.graph = new SceneGraph(async (sceneUuid, isGroup) => {
+            const {sceneItems} = isGroup
+                ? await this.obs.call('GetGroupSceneItemList', {sceneUuid})
+                : await this.obs.call('GetSceneItemList', {sceneUuid});
+
+            return sceneItems.map(item => ({
+                sceneItemId: item['sceneItemId'] as number,
+                sourceUuid: item['sourceUuid'] as string,
+                enabled: item['sceneItemEnabled'] as boolean,
+                nested: item['sourceType'] === 'OBS_SOURCE_TYPE_SCENE',
+                isGroup: item['isGroup'] === true,
+            }));
+        });
+
+        this.listen();
+    }
+
+    get id() {
+        return this.config.id;
+    }
+
+    async start() {
+        this.stopped = false;
+        this.validateTimer ??= setInterval(() => {
+            if (this.connected) void this.refreshSceneList();
+        }, sceneListValidateMs);
+        try {
+            await this.obs.connect(this.config.address, this.config.password);
+        } catch (error) {
+            // ConnectionClosed retries
+            console.error(`Failed to connect to OBS ${this.id}:`, error);
+        }
+    }
+
+    async stop() {
+        this.stopped = true;
+        if (this.reconnectTimer) {
+            clearTimeout(this.reconnectTimer);
+            this.reconnectTimer = null;
+        }
+        if (this.validateTimer) {
+            clearInterval(this.validateTimer);
+            this.validateTimer = null;
+        }
+        this.connected = false;
+        try {
+            await this.obs.disconnect();
+        } catch (error) {
+            console.error(`Error disconnecting from OBS ${this.id}:`, error);
+        }
+    }
+
+    // every scene visible in program/preview of this OBS, as tally index keys
+    async liveScenes(): Promise<LiveScenes> {
+        return {
+            program: this.qualify(await this.graph.closure(this.model.programSceneUuid)),
+            preview: this.qualify(await this.graph.closure(this.model.previewSceneUuid)),
+        };
+    }
+
+    // from memory, no OBS round trip
+    get sceneList(): readonly ObsScene[] {
+        return this.scenes;
+    }
+
+    async refreshSceneList() {
+        try {
+            const {scenes} = await this.obs.call('GetSceneList');
+            this.setSceneList(scenes);
+        } catch (error) {
+            console.error(`Error fetching scene list from OBS ${this.id}:`, error);
+        }
+    }
+
+    // corrects the model if we missed an event, e.g. while reconnecting
+    async reconcile() {
+        if (!this.connected) {
+            console.warn(`Not connected to OBS ${this.id}, skipping scene reconciliation`);
+            return;
+        }
+
+        try {
+            const changed = await this.model.reconcile(async () => {
+                const {studioModeEnabled} = await this.obs.call('GetStudioModeEnabled');
+                const {currentProgramSceneUuid} = await this.obs.call('GetCurrentProgramScene');
+                const previewSceneUuid = studioModeEnabled ? (await this.obs.call('GetCurrentPreviewScene')).currentPreviewSceneUuid : null;
+                return {programSceneUuid: currentProgramSceneUuid, previewSceneUuid, studioModeEnabled};
+            });
+
+            if (changed) {
+                console.log(`Scene model of OBS ${this.id} reconciled, program:`, this.model.programSceneUuid, 'preview:', this.model.previewSceneUuid);
+                this.onChange(this, 'reconcile');
+            }
+        } catch (error) {
+            console.error(`Error fetching scenes from OBS ${this.id}:`, error);
+        }
+    }
+
+    private setSceneList(scenes: { [key: string]: unknown }[]) {
+        const next = scenes.map(scene => ({
+            sceneUuid: scene['sceneUuid'] as string,
+            sceneName: scene['sceneName'] as string,
+            sceneIndex: scene['sceneIndex'] as number,
+            instance: this.id,
+        }));
+        const changed = next.length !== this.scenes.length || next.some((scene, i) => {
+            const known = this.scenes[i]!;
+            return scene.sceneUuid !== known.sceneUuid || scene.sceneName !== known.sceneName || scene.sceneIndex !== known.sceneIndex;
+        });
+        if (!changed) return;
+
+        this.scenes = next;
+        this.onChange(this, 'sceneList');
+    }
+
+    private qualify(scenes: ReadonlySet<SceneUuid>): ReadonlySet<string> {
+        let keys = this.qualified.get(scenes);
+        if (!keys) {
+            keys = new Set([...scenes].map(scene => sceneKey(this.id, scene)));
+            this.qualified.set(scenes, keys);
+        }
+        return keys;
+    }
+
+    private listen() {
+        const obs = this.obs;
+
+        obs.on('ConnectionOpened', () => {
+            console.log(`Connected to OBS ${this.id} successfully`);
+        });
+
+        obs.on('ConnectionClosed', () => {
+            const wasConnected = this.connected;
+            this.connected = false;
+            if (wasConnected) this.onChange(this, 'connection');
+            if (this.stopped) return;
+
+            console.warn(`Connection to OBS ${this.id} closed, attempting to reconnect in 5 seconds...`);
+            this.reconnectTimer = setTimeout(async () => {
+                this.reconnectTimer = null;
+                try {
+                    await obs.connect(this.config.address, this.config.password);
+                    console.log(`Reconnected to OBS ${this.id} successfully`);
+                } catch (error) {
+                    console.error(`Failed to reconnect to OBS ${this.id}:`, error);
+                }
+            }, 5000);
+        });
+
+        obs.on('ConnectionError', (error) => {
+            this.connected = false;
+            console.error(`OBS ${this.id} WebSocket error:`, error);
+        });
+
+        // The events carry the new scene, so the hot path needs no OBS round trip. A studio mode transition sends
+        // program and preview back to back; the scheduler merges them into one update, so the lights never see the
+        // half-way state.
+        obs.on('CurrentProgramSceneChanged', (event) => {
+            if (this.model.applyProgramScene(event.sceneUuid)) this.onChange(this, 'event');
+        });
+
+        obs.on('CurrentPreviewSceneChanged', (event) => {
+            if (this.model.applyPreviewScene(event.sceneUuid)) this.onChange(this, 'event');
+        });
+
+        obs.on('StudioModeStateChanged', (event) => {
+            if (this.model.applyStudioMode(event.studioModeEnabled)) this.onChange(this, 'event');
+        });
+
+        // scene item changes only matter if they change what is nested in program or preview, the update finds out
+        obs.on('SceneItemEnableStateChanged', (event) => {
+            this.graph.itemEnabled(event.sceneUuid, event.sceneItemId, event.sceneItemEnabled);
+            this.onChange(this, 'graph');
+        });
+
+        obs.on('SceneItemCreated', (event) => {
+            this.graph.itemCreated(event.sceneUuid);
+            this.onChange(this, 'graph');
+        });
+
+        obs.on('SceneItemRemoved', (event) => {
+            this.graph.itemRemoved(event.sceneUuid, event.sceneItemId);
+            this.onChange(this, 'graph');
+        });
+
+        obs.on('SceneRemoved', (event) => {
+            this.graph.sceneRemoved(event.sceneUuid);
+            this.onChange(this, 'graph');
+            if (event.isGroup) return;
+            this.scenes = this.scenes.filter(scene => scene.sceneUuid !== event.sceneUuid);
+            this.onChange(this, 'sceneList');
+        });
+
+        // the scene list follows the events; the indices are only right again once SceneListChanged arrives
+        obs.on('SceneCreated', (event) => {
+            if (event.isGroup) return;
+            this.scenes = [...this.scenes, {sceneUuid: event.sceneUuid, sceneName: event.sceneName, sceneIndex: this.scenes.length, instance: this.id}];
+            this.onChange(this, 'sceneList');
+        });
+
+        obs.on('SceneNameChanged', (event) => {
+            this.scenes = this.scenes.map(scene => scene.sceneUuid === event.sceneUuid ? {...scene, sceneName: event.sceneName} : scene);
+            this.onChange(this, 'sceneList');
+        });
+
+        obs.on('SceneListChanged', (event) => {
+            this.setSceneList(event.scenes);
+        });
+
+        obs.on('Identified', async () => {
+            this.connected = true;
+
+            // we may have missed scene item events while disconnected
+            this.graph.clear();
+
+            await this.reconcile();
+            this.onChange(this, 'connection');
+
+            // the rest of the graph, so switching to another scene later needs no OBS round trip
+            try {
+                await this.refreshSceneList();
+                await this.graph.preload(this.scenes.map(scene => scene.sceneUuid));
+            } catch (error) {
+                console.error(`Error loading scene items from OBS ${this.id}:`, error);
+            }
+        });
+    }
+}
@@ -0,0 +1,137 @@
+import type {SceneUuid} from './types.js';
+
+export interface SceneGraphItem {
+    sceneItemId: number;
+    sourceUuid: string;
+    enabled: boolean;
+    nested: boolean; // the source is a scene or group
+    isGroup: boolean;
+}
+
+// Loads the items of a scene (or group) from OBS.
+export type SceneItemLoader = (sceneUuid: SceneUuid, isGroup: boolean) => Promise<SceneGraphItem[]>;
+
+// Cached scene-item graph. closure(root) is every scene and group visible through enabled items from root, root
+// itself included. Items are loaded from OBS once and then kept current from scene-item events; each event only
+// touches the scene it is about and drops the cached closures that contain that scene.
+export class SceneGraph {
+    private readonly items = new Map<SceneUuid, Map<number, SceneGraphItem>>();
+    private readonly groups = new Set<SceneUuid>();
+    private readonly stale = new Set<SceneUuid>(); // items changed in a way the event does not describe
+    private readonly closures = new Map<SceneUuid, Set<SceneUuid>>();
+    private generation = 0; // bumped by every change, a walk that saw one is not cached
+
+    readonly stats = {loads: 0, closureHits: 0, closureMisses: 0, invalidations: 0};
+
+    constructor(private readonly loadItems: SceneItemLoader, private readonly maxCachedClosures = 32) {
+    }
+
+    async closure(root: SceneUuid | null): Promise<ReadonlySet<SceneUuid>> {
+        if (!root) return new Set();
+
+        const cached = this.closures.get(root);
+        if (cached) {
+            this.stats.closureHits++;
+            return cached;
+        }
+        this.stats.closureMisses++;
+
+        const generation = this.generation;
+        const closure = new Set<SceneUuid>([root]);
+        const queue: SceneUuid[] = [root];
+        while (queue.length > 0) {
+            const scene = queue.shift()!;
+            for (const item of (await this.itemsOf(scene)).values()) {
+                if (!item.nested || !item.enabled || closure.has(item.sourceUuid)) continue;
+                if (item.isGroup) this.groups.add(item.sourceUuid);
+                closure.add(item.sourceUuid);
+                queue.push(item.sourceUuid);
+            }
+        }
+
+        // an event may have changed a scene we walked while we were waiting for OBS, don't cache then
+        if (generation === this.generation) {
+            if (this.closures.size >= this.maxCachedClosures) {
+                // oldest first, Map keeps insertion order
+                this.closures.delete(this.closures.keys().next().value!);
+            }
+            this.closures.set(root, closure);
+        }
+        return closure;
+    }
+
+    // loads every given scene that is not cached yet, so later closures need no OBS round trip
+    async preload(sceneUuids: SceneUuid[]) {
+        await Promise.all(sceneUuids.map(scene => this.itemsOf(scene)));
+    }
+
+    itemEnabled(sceneUuid: SceneUuid, sceneItemId: number, enabled: boolean) {
+        const item = this.items.get(sceneUuid)?.get(sceneItemId);
+        if (item) {
+            if (item.enabled === enabled) return;
+            item.enabled = enabled;
+        } else {
+            this.stale.add(sceneUuid);
+        }
+        this.invalidate(sceneUuid);
+    }
+
+    itemRemoved(sceneUuid: SceneUuid, sceneItemId: number) {
+        this.items.get(sceneUuid)?.delete(sceneItemId);
+        this.invalidate(sceneUuid);
+    }
+
+    // the event does not say whether the new source is a scene, so the scene is reloaded when needed next
+    itemCreated(sceneUuid: SceneUuid) {
+        this.stale.add(sceneUuid);
+        this.invalidate(sceneUuid);
+    }
+
+    sceneRemoved(sceneUuid: SceneUuid) {
+        this.items.delete(sceneUuid);
+        this.groups.delete(sceneUuid);
+        this.stale.delete(sceneUuid);
+        this.invalidate(sceneUuid);
+    }
+
+    clear() {
+        this.generation++;
+        this.items.clear();
+        this.groups.clear();
+        this.stale.clear();
+        this.closures.clear();
+    }
+
+    private async itemsOf(sceneUuid: SceneUuid): Promise<Map<number, SceneGraphItem>> {
+        const cached = this.items.get(sceneUuid);
+        if (cached && !this.stale.has(sceneUuid)) return cached;
+
+        this.stale.delete(sceneUuid);
+        this.stats.loads++;
+        let loaded: SceneGraphItem[] = [];
+        try {
+            loaded = await this.loadItems(sceneUuid, this.groups.has(sceneUuid));
+        } catch (error) {
+            // treated as empty for now, loaded again next time; the walk that needed it is not cached
+            this.stale.add(sceneUuid);
+            this.generation++;
+            if (error instanceof Error) {
+                console.warn(`Failed to load items of scene ${sceneUuid}:`, error.message);
+            }
+        }
+
+        const items = new Map(loaded.map(item => [item.sceneItemId, item]));
+        this.items.set(sceneUuid, items);
+        return items;
+    }
+
+    private invalidate(sceneUuid: SceneUuid) {
+        this.generation++;
+        for (const [root, closure] of this.closures) {
+            if (closure.has(sceneUuid)) {
+                this.closures.delete(root);
+                this.stats.invalidations++;
+            }
+        }
+    }
+}
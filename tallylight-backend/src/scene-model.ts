@@ -0,0 +1,78 @@
+import type {SceneUuid} from './types.js';
+
+export interface SceneSnapshot {
+    programSceneUuid: SceneUuid | null;
+    previewSceneUuid: SceneUuid | null;
+    studioModeEnabled: boolean;
+}
+
+// Local model of OBS' program/preview/studio mode state, kept current from event payloads so a tally change needs
+// no OBS round trip. Every event bumps the sequence number. A periodic query is only applied if no event arrived
+// while it was in flight, otherwise it may be older than the model and is dropped.
+export class SceneModel implements SceneSnapshot {
+    programSceneUuid: SceneUuid | null = null;
+    previewSceneUuid: SceneUuid | null = null;
+    studioModeEnabled = false;
+
+    sequence = 0;
+
+    readonly stats = {
+        events: 0,
+        reconciliations: 0,
+        reconciliationsDropped: 0, // overtaken by an event
+        drift: 0, // reconciliations that found the model wrong
+    };
+
+    applyProgramScene(sceneUuid: SceneUuid): boolean {
+        this.stats.events++;
+        this.sequence++;
+        if (this.programSceneUuid === sceneUuid) return false;
+        this.programSceneUuid = sceneUuid;
+        return true;
+    }
+
+    applyPreviewScene(sceneUuid: SceneUuid): boolean {
+        this.stats.events++;
+        this.sequence++;
+        if (this.previewSceneUuid === sceneUuid) return false;
+        this.previewSceneUuid = sceneUuid;
+        return true;
+    }
+
+    applyStudioMode(enabled: boolean): boolean {
+        this.stats.events++;
+        this.sequence++;
+        if (this.studioModeEnabled === enabled) return false;
+        this.studioModeEnabled = enabled;
+        // without studio mode there is no preview; when it is enabled, OBS sends the preview scene separately
+        if (!enabled) this.previewSceneUuid = null;
+        return true;
+    }
+
+    async reconcile(query: () => Promise<SceneSnapshot>): Promise<boolean> {
+        const sequence = this.sequence;
+        const snapshot = await query();
+
+        this.stats.reconciliations++;
+        if (this.sequence !== sequence) {
+            this.stats.reconciliationsDropped++;
+            return false;
+        }
+
+        if (snapshot.programSceneUuid === this.programSceneUuid &&
+            snapshot.previewSceneUuid === this.previewSceneUuid &&
+            snapshot.studioModeEnabled === this.studioModeEnabled) {
+            return false;
+        }
+
+        if (this.sequence > 0) {
+            // sequence 0 is the initial query, not drift
+            this.stats.drift++;
+        }
+        this.programSceneUuid = snapshot.programSceneUuid;
+        this.previewSceneUuid = snapshot.previewSceneUuid;
+        this.studioModeEnabled = snapshot.studioModeEnabled;
+        this.sequence++;
+        return true;
+    }
+}
@@ -0,0 +1,87 @@
+import {performance} from 'perf_hooks';
+
+// Single-flight scheduler. At most one run of the task is in progress. Requests that arrive meanwhile are merged
+// into one follow-up run, which starts after the current run finished and therefore sees the newest state.
+// A short window before a run merges events that OBS sends back to back (program + preview on a transition).
+
+export interface SchedulerStats {
+    requests: number;
+    runs: number;
+    coalescingRatio: number; // requests per run
+    avgQueueDelayMs: number; // first request of a run until the run started
+    maxQueueDelayMs: number;
+    avgRunMs: number;
+}
+
+export class CoalescingScheduler {
+    private running = false;
+    private queuedSince: number | null = null;
+    private waiters: (() => void)[] = [];
+
+    private requests = 0;
+    private runs = 0;
+    private totalQueueDelayMs = 0;
+    private maxQueueDelayMs = 0;
+    private totalRunMs = 0;
+
+    constructor(
+        private readonly task: () => Promise<void>,
+        private readonly windowMs = 5,
+    ) {
+    }
+
+    // resolves once a run that started after this request has finished
+    request(): Promise<void> {
+        this.requests++;
+        const done = new Promise<void>(resolve => this.waiters.push(resolve));
+
+        if (this.queuedSince === null) {
+            this.queuedSince = performance.now();
+            if (!this.running) {
+                setTimeout(() => this.run(), this.windowMs);
+            }
+        }
+
+        return done;
+    }
+
+    get stats(): SchedulerStats {
+        return {
+            requests: this.requests,
+            runs: this.runs,
+            coalescingRatio: this.runs ? this.requests / this.runs : 0,
+            avgQueueDelayMs: this.runs ? this.totalQueueDelayMs / this.runs : 0,
+            maxQueueDelayMs: this.maxQueueDelayMs,
+            avgRunMs: this.runs ? this.totalRunMs / this.runs : 0,
+        };
+    }
+
+    private async run() {
+        if (this.running || this.queuedSince === null) return;
+
+        this.running = true;
+        const start = performance.now();
+        const queueDelay = start - this.queuedSince;
+        this.queuedSince = null;
+        const waiters = this.waiters;
+        this.waiters = [];
+
+        this.runs++;
+        this.totalQueueDelayMs += queueDelay;
+        this.maxQueueDelayMs = Math.max(this.maxQueueDelayMs, queueDelay);
+
+        try {
+            await this.task();
+        } catch (error) {
+            console.error('Scheduled run failed:', error);
+        } finally {
+            this.totalRunMs += performance.now() - start;
+            this.running = false;
+            waiters.forEach(resolve => resolve());
+
+            if (this.queuedSince !== null) {
+                void this.run();
+            }
+        }
+    }
+}
@@ -0,0 +1,120 @@
+import type {FQDN, SceneUuid, TallyLightState} from './types.js';
+
+export interface ProgramPreview {
+    programSceneUuid: SceneUuid | null;
+    previewSceneUuid: SceneUuid | null;
+}
+
+// every scene (and group) that is visible in program/preview, the program/preview scene itself included.
+// Both empty means there is no program or preview scene at all.
+export interface LiveScenes {
+    program: ReadonlySet<SceneUuid>;
+    preview: ReadonlySet<SceneUuid>;
+}
+
+// Scene uuids are only unique within one OBS, so the index is keyed by instance and scene.
+export const sceneKey = (instance: string, sceneUuid: SceneUuid) => `${instance}/${sceneUuid}`;
+
+const noLights: ReadonlySet<FQDN> = new Set();
+const noScenes: ReadonlySet<SceneUuid> = new Set();
+
+// without nested scenes, only the program/preview scenes themselves are live
+export const liveScenesOf = ({programSceneUuid, previewSceneUuid}: ProgramPreview): LiveScenes => ({
+    program: programSceneUuid ? new Set([programSceneUuid]) : noScenes,
+    preview: previewSceneUuid ? new Set([previewSceneUuid]) : noScenes,
+});
+
+const isError = (live: LiveScenes) => live.program.size === 0 && live.preview.size === 0;
+
+const intersects = (a: ReadonlySet<SceneUuid>, b: ReadonlySet<SceneUuid>) => {
+    const [small, large] = a.size <= b.size ? [a, b] : [b, a];
+    for (const scene of small) {
+        if (large.has(scene)) return true;
+    }
+    return false;
+};
+
+// Scene -> lights index, kept in step with each light's visibleInScenes. Computing a light's state is a set lookup
+// and a program/preview change only needs to look at the lights in the scenes that were left or entered.
+export class TallyIndex {
+    private readonly lightsByScene = new Map<SceneUuid, Set<FQDN>>();
+    private readonly scenesByLight = new Map<FQDN, Set<SceneUuid>>();
+
+    setLightScenes(fqdn: FQDN, scenes: Iterable<SceneUuid>) {
+        const next = new Set(scenes);
+        const previous = this.scenesByLight.get(fqdn) ?? new Set<SceneUuid>();
+
+        for (const scene of previous) {
+            if (!next.has(scene)) this.unlink(fqdn, scene);
+        }
+        for (const scene of next) {
+            if (previous.has(scene)) continue;
+            let lights = this.lightsByScene.get(scene);
+            if (!lights) {
+                lights = new Set();
+                this.lightsByScene.set(scene, lights);
+            }
+            lights.add(fqdn);
+        }
+
+        this.scenesByLight.set(fqdn, next);
+    }
+
+    removeLight(fqdn: FQDN) {
+        for (const scene of this.scenesByLight.get(fqdn) ?? []) {
+            this.unlink(fqdn, scene);
+        }
+        this.scenesByLight.delete(fqdn);
+    }
+
+    lightsInScene(scene: SceneUuid | null): ReadonlySet<FQDN> {
+        return scene ? this.lightsByScene.get(scene) ?? noLights : noLights;
+    }
+
+    stateOf(fqdn: FQDN, live: LiveScenes): TallyLightState {
+        if (isError(live)) {
+            return 'ERROR';
+        }
+
+        const scenes = this.scenesByLight.get(fqdn);
+        if (scenes && intersects(scenes, live.program)) {
+            return 'PROGRAM';
+        } else if (scenes && intersects(scenes, live.preview)) {
+            return 'PREVIEW';
+        } else if (scenes && scenes.size > 0) {
+            return 'STANDBY';
+        }
+        return 'OFF';
+    }
+
+    // lights whose state can differ between the two, null if that may be any light
+    affectedLights(from: LiveScenes, to: LiveScenes): Set<FQDN> | null {
+        const fromError = isError(from);
+        const toError = isError(to);
+        if (fromError || toError) {
+            return fromError && toError ? new Set() : null;
+        }
+
+        const affected = new Set<FQDN>();
+        const addDifference = (a: ReadonlySet<SceneUuid>, b: ReadonlySet<SceneUuid>) => {
+            if (a === b) return;
+            for (const scene of a) {
+                if (b.has(scene)) continue;
+                for (const fqdn of this.lightsInScene(scene)) affected.add(fqdn);
+            }
+        };
+
+        addDifference(from.program, to.program);
+        addDifference(to.program, from.program);
+        addDifference(from.preview, to.preview);
+        addDifference(to.preview, from.preview);
+        return affected;
+    }
+
+    private unlink(fqdn: FQDN, scene: SceneUuid) {
+        const lights = this.lightsByScene.get(scene);
+        if (!lights) return;
+        lights.delete(fqdn);
+        if (lights.size === 0) this.lightsByScene.delete(scene);
+    }
+}
@@ -0,0 +1,167 @@
+import dgram from 'dgram';
+import net from 'net';
+import {encodeTsl5Batches, type TslDisplayMessage, wrapTsl5ForTcp} from './tsl.js';
+
+// stays below a typical MTU, so a batch is never fragmented
+const maxPacketBytes = 1350;
+// UDP consumers only ever get deltas; a lost datagram is corrected by this periodic full refresh
+const udpRefreshMs = 10000;
+const tcpReconnectMs = 5000;
+
+interface TcpTarget {
+    url: string;
+    socket: net.Socket | null;
+    connected: boolean;
+    reconnectTimer: NodeJS.Timeout | null;
+}
+
+// Publishes per-display tally and labels as TSL UMD v5 to multiviewers and other tally consumers, over UDP and TCP.
+// Only displays whose tally or label differs from what was last published are sent, batched into as few packets as
+// possible. A TCP consumer gets the full state when it (re)connects.
+export class TslSender {
+    readonly stats = {flushes: 0, packets: 0, displays: 0, bytes: 0, refreshes: 0};
+
+    private readonly published = new Map<number, TslDisplayMessage>();
+    private readonly pending = new Map<number, TslDisplayMessage>();
+    private udp: dgram.Socket | null = null;
+    private udpTargets: { host: string; port: number }[] = [];
+    private tcpTargets: TcpTarget[] = [];
+    private refreshTimer: NodeJS.Timeout | null = null;
+
+    constructor(private readonly screen = 0) {
+    }
+
+    // udp://host:port or tcp://host:port
+    setTargets(urls: string[]) {
+        this.stop();
+
+        for (const url of urls) {
+            const {protocol, hostname, port} = new URL(url);
+            if (protocol === 'udp:') {
+                this.udpTargets.push({host: hostname, port: parseInt(port, 10)});
+            } else if (protocol === 'tcp:') {
+                const target: TcpTarget = {url, socket: null, connected: false, reconnectTimer: null};
+                this.tcpTargets.push(target);
+                this.connect(target, hostname, parseInt(port, 10));
+            }
+        }
+
+        if (this.udpTargets.length > 0) {
+            this.udp = dgram.createSocket('udp4');
+            this.udp.on('error', (error) => {
+                console.error('TSL UMD output error:', error.message);
+            });
+            this.refreshTimer = setInterval(() => {
+                this.stats.refreshes++;
+                this.sendUdp([...this.published.values()]);
+            }, udpRefreshMs);
+        }
+    }
+
+    get active() {
+        return this.udpTargets.length > 0 || this.tcpTargets.length > 0;
+    }
+
+    get tcpConnected() {
+        return this.tcpTargets.filter(target => target.connected).length;
+    }
+
+    // queued until flush() if it differs from what consumers have
+    set(index: number, tally: number, label: string) {
+        const published = this.published.get(index);
+        if (published && published.tally === tally && published.label === label) {
+            this.pending.delete(index);
+            return;
+        }
+        this.pending.set(index, {index, tally, label});
+    }
+
+    // the display no longer belongs to a light: tally off, label empty
+    clear(index: number) {
+        this.set(index, 0, '');
+    }
+
+    flush() {
+        if (this.pending.size === 0) return;
+
+        const displays = [...this.pending.values()];
+        this.pending.clear();
+        for (const display of displays) {
+            if (display.tally === 0 && display.label === '') {
+                this.published.delete(display.index);
+            } else {
+                this.published.set(display.index, display);
+            }
+        }
+
+        if (!this.active) return;
+        this.stats.flushes++;
+        this.stats.displays += displays.length;
+        this.sendUdp(displays);
+        for (const target of this.tcpTargets) {
+            this.sendTcp(target, displays);
+        }
+    }
+
+    stop() {
+        if (this.refreshTimer) clearInterval(this.refreshTimer);
+        this.refreshTimer = null;
+        this.udp?.close();
+        this.udp = null;
+        this.udpTargets = [];
+
+        for (const target of this.tcpTargets) {
+            if (target.reconnectTimer) clearTimeout(target.reconnectTimer);
+            target.reconnectTimer = null;
+            target.socket?.destroy();
+        }
+        this.tcpTargets = [];
+    }
+
+    private sendUdp(displays: TslDisplayMessage[]) {
+        if (!this.udp || displays.length === 0) return;
+        for (const packet of encodeTsl5Batches(this.screen, displays, maxPacketBytes)) {
+            for (const {host, port} of this.udpTargets) {
+                this.stats.packets++;
+                this.stats.bytes += packet.length;
+                this.udp.send(packet, port, host);
+            }
+        }
+    }
+
+    private sendTcp(target: TcpTarget, displays: TslDisplayMessage[]) {
+        if (!target.connected || !target.socket || displays.length === 0) return;
+        for (const packet of encodeTsl5Batches(this.screen, displays, maxPacketBytes)) {
+            const framed = wrapTsl5ForTcp(packet);
+            this.stats.packets++;
+            this.stats.bytes += framed.length;
+            target.socket.write(framed);
+        }
+    }
+
+    private connect(target: TcpTarget, host: string, port: number) {
+        const socket = net.createConnection({host, port});
+        socket.setNoDelay(true);
+        target.socket = socket;
+
+        socket.on('connect', () => {
+            target.connected = true;
+            console.log('Connected to TSL UMD consumer', target.url);
+            this.sendTcp(target, [...this.published.values()]);
+        });
+        socket.on('data', () => {
+            // v5 consumers may send ACK/NAK, nothing to do with them
+        });
+        socket.on('error', (error) => {
+            console.warn(`TSL UMD consumer ${target.url}:`, error.message);
+        });
+        socket.on('close', () => {
+            target.connected = false;
+            if (target.socket !== socket || !this.tcpTargets.includes(target)) return;
+            target.reconnectTimer = setTimeout(() => {
+                target.reconnectTimer = null;
+                this.connect(target, host, port);
+            }, tcpReconnectMs);
+        });
+    }
+}
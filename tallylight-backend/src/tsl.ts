@@ -0,0 +1,253 @@
+import dgram from 'dgram';
+import {type LiveScenes, sceneKey} from './tally-index.js';
+
+// TSL UMD tally from hardware switchers. Displays show up next to the OBS scenes as scenes of this pseudo instance,
+// so lights are mapped to them like to any scene and go through the same tally index and fan-out.
+export const tslInstance = 'tsl';
+
+// v5 index that addresses every display of a screen
+const broadcastIndex = 0xffff;
+
+// v3.1: fixed 18 byte message, address + 0x80, control (bit 0 tally 1, bit 1 tally 2), 16 characters
+const v31Length = 18;
+// v5: PBC (uint16 LE, bytes that follow), VER, FLAGS, SCREEN (uint16 LE), then per display
+//     INDEX (uint16 LE), CONTROL (uint16 LE), LENGTH (uint16 LE), TEXT
+const v5HeaderLength = 6;
+const v5DisplayHeaderLength = 6;
+const v5FlagUnicode = 0x01;
+const v5FlagScreenControl = 0x02;
+const v5ControlData = 0x8000; // the display message carries control data, not text
+
+// tally bits as passed to the handler; v3.1 tally 1 and v5 red are program, v3.1 tally 2 and v5 green are preview,
+// v5 amber is both
+export const tslProgram = 0x01;
+export const tslPreview = 0x02;
+
+// called for each display message; the label is not decoded, it is buf[labelStart, labelEnd)
+export type TslDisplayHandler = (screen: number, index: number, tally: number, buf: Buffer, labelStart: number, labelEnd: number, utf16: boolean) => void;
+
+// Parses a v3.1 or v5 packet without allocating. Returns the number of display messages, -1 if it is neither.
+export const parseTslPacket = (buf: Buffer, onDisplay: TslDisplayHandler): number => {
+    if (buf.length === v31Length && buf[0]! >= 0x80) {
+        const control = buf[1]!;
+        onDisplay(0, buf[0]! - 0x80, control & (tslProgram | tslPreview), buf, 2, v31Length, false);
+        return 1;
+    }
+
+    if (buf.length < v5HeaderLength) return -1;
+    const end = buf.readUInt16LE(0) + 2;
+    if (end > buf.length || end < v5HeaderLength) return -1;
+
+    const flags = buf[3]!;
+    if (flags & v5FlagScreenControl) return 0;
+    const screen = buf.readUInt16LE(4);
+    const utf16 = (flags & v5FlagUnicode) !== 0;
+
+    let count = 0;
+    let offset = v5HeaderLength;
+    while (offset + v5DisplayHeaderLength <= end) {
+        const index = buf.readUInt16LE(offset);
+        const control = buf.readUInt16LE(offset + 2);
+        const length = buf.readUInt16LE(offset + 4);
+        const labelStart = offset + v5DisplayHeaderLength;
+        const labelEnd = labelStart + length;
+        if (labelEnd > end) return count > 0 ? count : -1;
+
+        if (!(control & v5ControlData)) {
+            // right hand, text and left hand tally, 0 off, 1 red, 2 green, 3 amber
+            const tally = (control | control >> 2 | control >> 4) & (tslProgram | tslPreview);
+            onDisplay(screen, index, tally, buf, labelStart, labelEnd, utf16);
+            count++;
+        }
+        offset = labelEnd;
+    }
+    return count;
+};
+
+export interface TslDisplayMessage {
+    index: number;
+    tally: number; // tslProgram | tslPreview
+    label: string;
+}
+
+// Encodes a v5 packet with the given displays, the tally on all three lamps.
+export const encodeTsl5 = (screen: number, displays: TslDisplayMessage[]): Buffer => {
+    const labels = displays.map(display => Buffer.from(display.label, 'ascii'));
+    const length = v5HeaderLength + labels.reduce((sum, label) => sum + v5DisplayHeaderLength + label.length, 0);
+    const buf = Buffer.alloc(length);
+
+    buf.writeUInt16LE(length - 2, 0);
+    buf[2] = 0; // version
+    buf[3] = 0; // flags
+    buf.writeUInt16LE(screen, 4);
+
+    let offset = v5HeaderLength;
+    displays.forEach((display, i) => {
+        const lamp = display.tally & (tslProgram | tslPreview);
+        buf.writeUInt16LE(display.index, offset);
+        buf.writeUInt16LE(lamp | lamp << 2 | lamp << 4 | 3 << 6, offset + 2);
+        buf.writeUInt16LE(labels[i]!.length, offset + 4);
+        labels[i]!.copy(buf, offset + v5DisplayHeaderLength);
+        offset += v5DisplayHeaderLength + labels[i]!.length;
+    });
+    return buf;
+};
+
+// Splits the displays over as few v5 packets as fit in maxBytes each.
+export const encodeTsl5Batches = (screen: number, displays: TslDisplayMessage[], maxBytes: number): Buffer[] => {
+    const packets: Buffer[] = [];
+    let batch: TslDisplayMessage[] = [];
+    let length = v5HeaderLength;
+    for (const display of displays) {
+        const size = v5DisplayHeaderLength + Buffer.byteLength(display.label, 'ascii');
+        if (batch.length > 0 && length + size > maxBytes) {
+            packets.push(encodeTsl5(screen, batch));
+            batch = [];
+            length = v5HeaderLength;
+        }
+        batch.push(display);
+        length += size;
+    }
+    if (batch.length > 0) packets.push(encodeTsl5(screen, batch));
+    return packets;
+};
+
+// v5 over TCP: DLE/STX in front of every packet, a DLE inside the packet is sent twice
+const dle = 0xfe;
+const stx = 0x02;
+
+export const wrapTsl5ForTcp = (packet: Buffer): Buffer => {
+    let stuffed = 0;
+    for (const byte of packet) {
+        if (byte === dle) stuffed++;
+    }
+
+    const buf = Buffer.alloc(2 + packet.length + stuffed);
+    buf[0] = dle;
+    buf[1] = stx;
+    let offset = 2;
+    for (const byte of packet) {
+        buf[offset++] = byte;
+        if (byte === dle) buf[offset++] = dle;
+    }
+    return buf;
+};
+
+export const encodeTsl31 = (address: number, tally: number, label: string): Buffer => {
+    const buf = Buffer.alloc(v31Length, 0x20);
+    buf[0] = 0x80 + (address & 0x7f);
+    buf[1] = tally & (tslProgram | tslPreview) | 0x30; // full brightness
+    buf.write(label.slice(0, v31Length - 2), 2, 'ascii');
+    return buf;
+};
+
+export interface TslDisplay {
+    screen: number;
+    index: number;
+    key: string; // tally index key, see sceneKey()
+    tally: number;
+    label: string;
+    labelBytes: Buffer; // raw label, compared in place so an unchanged label is not decoded again
+    labelLength: number;
+}
+
+const displayId = (screen: number, index: number) => screen * 0x10000 + index;
+
+// Listens for TSL UMD v3.1 and v5 over UDP and keeps the last tally and label of every display seen.
+export class TslReceiver {
+    readonly displays = new Map<number, TslDisplay>();
+    readonly stats = {packets: 0, invalid: 0, displayMessages: 0, changes: 0};
+
+    private socket: dgram.Socket | null = null;
+    private readonly program = new Set<string>();
+    private readonly preview = new Set<string>();
+    private live: LiveScenes | null = null; // snapshot of program/preview, taken when an update asks for it
+    private readonly onDisplay: TslDisplayHandler;
+
+    // tallyChanged is false if only the label changed
+    constructor(private readonly onChange: (display: TslDisplay, tallyChanged: boolean) => void) {
+        // bound once, not per packet
+        this.onDisplay = (screen, index, tally, buf, labelStart, labelEnd, utf16) => {
+            this.stats.displayMessages++;
+            if (index === broadcastIndex) {
+                for (const display of this.displays.values()) {
+                    if (display.screen === screen) this.apply(display, tally, buf, labelStart, labelEnd, utf16);
+                }
+                return;
+            }
+
+            let display = this.displays.get(displayId(screen, index));
+            if (!display) {
+                display = {screen, index, key: sceneKey(tslInstance, `${screen}:${index}`), tally: 0, label: '', labelBytes: Buffer.alloc(0), labelLength: 0};
+                this.displays.set(displayId(screen, index), display);
+            }
+            this.apply(display, tally, buf, labelStart, labelEnd, utf16);
+        };
+    }
+
+    start(port: number) {
+        this.stop();
+        const socket = dgram.createSocket({type: 'udp4', reuseAddr: true});
+        socket.on('message', (msg) => this.handle(msg));
+        socket.on('error', (error) => {
+            console.error('TSL UMD listener error:', error.message);
+        });
+        socket.bind(port, () => {
+            console.log('Listening for TSL UMD on UDP port', port);
+        });
+        this.socket = socket;
+    }
+
+    // the bound port, null while not listening
+    get port(): number | null {
+        try {
+            return this.socket?.address().port ?? null;
+        } catch {
+            return null;
+        }
+    }
+
+    stop() {
+        this.socket?.close();
+        this.socket = null;
+    }
+
+    handle(packet: Buffer) {
+        this.stats.packets++;
+        if (parseTslPacket(packet, this.onDisplay) < 0) {
+            this.stats.invalid++;
+        }
+    }
+
+    // displays with program/preview tally, as tally index keys; the same sets until a display changes
+    liveScenes(): LiveScenes {
+        this.live ??= {program: new Set(this.program), preview: new Set(this.preview)};
+        return this.live;
+    }
+
+    private apply(display: TslDisplay, tally: number, buf: Buffer, labelStart: number, labelEnd: number, utf16: boolean) {
+        const labelLength = labelEnd - labelStart;
+        const labelChanged = labelLength !== display.labelLength || buf.compare(display.labelBytes, 0, labelLength, labelStart, labelEnd) !== 0;
+        if (tally === display.tally && !labelChanged) return;
+
+        if (labelChanged) {
+            if (display.labelBytes.length < labelLength) {
+                display.labelBytes = Buffer.alloc(Math.max(labelLength, 16));
+            }
+            buf.copy(display.labelBytes, 0, labelStart, labelEnd);
+            display.labelLength = labelLength;
+            display.label = buf.toString(utf16 ? 'utf16le' : 'latin1', labelStart, labelEnd).trim();
+        }
+
+        const tallyChanged = tally !== display.tally;
+        if (tallyChanged) {
+            display.tally = tally;
+            if (tally & tslProgram) this.program.add(display.key); else this.program.delete(display.key);
+            if (tally & tslPreview) this.preview.add(display.key); else this.preview.delete(display.key);
+            this.live = null;
+        }
+
+        this.stats.changes++;
+        this.onChange(display, tallyChanged);
+    }
+}
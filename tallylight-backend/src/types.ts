@@ -0,0 +1,5 @@
+export type FQDN = string;
+
+export type SceneUuid = string;
+
+export type TallyLightState = 'OFF' | 'STANDBY' | 'PROGRAM' | 'PREVIEW' | 'ERROR';
@@ -0,0 +1,182 @@
+import net from 'net';
+import {type LiveScenes, sceneKey} from './tally-index.js';
+
+// vMix inputs show up as scenes of this pseudo instance (input number as scene), see TslReceiver for the same idea
+export const vmixInstance = 'vmix';
+
+export const vmixDefaultPort = 8099;
+const reconnectMs = 5000;
+
+const lf = 0x0a;
+const cr = 0x0d;
+const digitZero = 0x30;
+const tallyPrefix = Buffer.from('TALLY OK ', 'latin1');
+const xmlPrefix = Buffer.from('XML ', 'latin1');
+
+// per input: 0 off, 1 program, 2 preview
+const vmixProgram = 1;
+const vmixPreview = 2;
+
+// Client for the vMix TCP API. Subscribes to tally and keeps the state of every input. Responses are parsed from
+// the socket buffers as they arrive; a TALLY line is compared byte by byte against the last one, so an input only
+// counts as changed if its digit did.
+export class VmixClient {
+    readonly stats = {tallyLines: 0, changes: 0, connects: 0};
+    readonly titles = new Map<number, string>(); // input number -> title, from the XML state on connect
+    connected = false;
+
+    private socket: net.Socket | null = null;
+    private reconnectTimer: NodeJS.Timeout | null = null;
+    private host = '';
+    private port = vmixDefaultPort;
+
+    private tally = new Uint8Array(64);
+    private inputs = 0;
+    private readonly program = new Set<string>();
+    private readonly preview = new Set<string>();
+    private live: LiveScenes | null = null;
+
+    private rest: Buffer | null = null; // incomplete line or XML body from the previous chunk
+    private xmlBytes = 0; // > 0 while the body of an XML response is being read
+
+    constructor(private readonly onChange: () => void) {
+    }
+
+    // host or host:port
+    start(address: string) {
+        this.stop();
+        const [host, port] = address.split(':');
+        this.host = host!;
+        this.port = port ? parseInt(port, 10) : vmixDefaultPort;
+        this.connect();
+    }
+
+    stop() {
+        if (this.reconnectTimer) clearTimeout(this.reconnectTimer);
+        this.reconnectTimer = null;
+        const socket = this.socket;
+        this.socket = null;
+        socket?.destroy();
+        this.connected = false;
+    }
+
+    get inputCount() {
+        return this.inputs;
+    }
+
+    // inputs on program/preview, as tally index keys; the same sets until an input changes
+    liveScenes(): LiveScenes {
+        this.live ??= {program: new Set(this.program), preview: new Set(this.preview)};
+        return this.live;
+    }
+
+    // exposed for the mock server bench, the socket feeds it the same way
+    feed(chunk: Buffer) {
+        const data = this.rest ? Buffer.concat([this.rest, chunk]) : chunk;
+        this.rest = null;
+        let offset = 0;
+
+        while (offset < data.length) {
+            if (this.xmlBytes > 0) {
+                if (data.length - offset < this.xmlBytes) break;
+                this.handleXml(data.toString('utf8', offset, offset + this.xmlBytes));
+                offset += this.xmlBytes;
+                this.xmlBytes = 0;
+                continue;
+            }
+
+            const newline = data.indexOf(lf, offset);
+            if (newline < 0) break;
+            const end = newline > offset && data[newline - 1] === cr ? newline - 1 : newline;
+            this.handleLine(data, offset, end);
+            offset = newline + 1;
+        }
+
+        if (offset < data.length) {
+            // copied, so the socket's buffer is not kept alive
+            this.rest = Buffer.from(data.subarray(offset));
+        }
+    }
+
+    private connect() {
+        const socket = net.createConnection({host: this.host, port: this.port});
+        socket.setNoDelay(true);
+        this.socket = socket;
+        this.rest = null;
+        this.xmlBytes = 0;
+
+        socket.on('connect', () => {
+            this.connected = true;
+            this.stats.connects++;
+            console.log(`Connected to vMix at ${this.host}:${this.port}`);
+            // TALLY for the current state, the subscription only reports changes
+            socket.write('SUBSCRIBE TALLY\r\nTALLY\r\nXML\r\n');
+        });
+        socket.on('data', (chunk: Buffer) => this.feed(chunk));
+        socket.on('error', (error) => {
+            console.warn('vMix connection error:', error.message);
+        });
+        socket.on('close', () => {
+            if (this.socket !== socket) return;
+            // inputs keep their last state, like OBS scenes while OBS reconnects
+            this.connected = false;
+            this.reconnectTimer = setTimeout(() => {
+                this.reconnectTimer = null;
+                this.connect();
+            }, reconnectMs);
+        });
+    }
+
+    private handleLine(data: Buffer, start: number, end: number) {
+        if (startsWith(data, start, end, tallyPrefix)) {
+            this.handleTally(data, start + tallyPrefix.length, end);
+        } else if (startsWith(data, start, end, xmlPrefix)) {
+            this.xmlBytes = parseInt(data.toString('latin1', start + xmlPrefix.length, end), 10) || 0;
+        }
+    }
+
+    private handleTally(data: Buffer, start: number, end: number) {
+        this.stats.tallyLines++;
+        const inputs = end - start;
+        if (inputs > this.tally.length) {
+            const grown = new Uint8Array(Math.max(inputs, this.tally.length * 2));
+            grown.set(this.tally);
+            this.tally = grown;
+        }
+
+        let changed = false;
+        // inputs that are no longer listed were removed, they are off
+        const count = Math.max(inputs, this.inputs);
+        for (let i = 0; i < count; i++) {
+            const state = i < inputs ? data[start + i]! - digitZero : 0;
+            if (state === this.tally[i]) continue;
+
+            this.tally[i] = state;
+            const key = sceneKey(vmixInstance, String(i + 1));
+            if (state === vmixProgram) this.program.add(key); else this.program.delete(key);
+            if (state === vmixPreview) this.preview.add(key); else this.preview.delete(key);
+            changed = true;
+        }
+        this.inputs = inputs;
+
+        if (changed) {
+            this.live = null;
+            this.stats.changes++;
+            this.onChange();
+        }
+    }
+
+    private handleXml(xml: string) {
+        this.titles.clear();
+        for (const match of xml.matchAll(/<input\s[^>]*>/g)) {
+            const number = /\snumber="(\d+)"/.exec(match[0])?.[1];
+            const title = /\stitle="([^"]*)"/.exec(match[0])?.[1];
+            if (number && title !== undefined) {
+                this.titles.set(parseInt(number, 10), title.replace(/&quot;/g, '"').replace(/&lt;/g, '<').replace(/&gt;/g, '>').replace(/&amp;/g, '&'));
+            }
+        }
+    }
+}
+
+const startsWith = (data: Buffer, start: number, end: number, prefix: Buffer) =>
+    end - start >= prefix.length && data.compare(prefix, 0, prefix.length, start, start + prefix.length) === 0;
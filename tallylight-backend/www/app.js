@@ -13,6 +13,13 @@ $(document).ready(() => {
     }
      */
     let configuredFqdns = [];
+    let configuredLightsByFqdn = {};
+
+    // scenes are identified by OBS instance and scene uuid, see SceneRef in index.ts
+    const isSceneSelected = (config, scene) => (config.visibleInScenes || [])
+        .some(ref => ref.instance === scene.instance && ref.sceneUuid === scene.sceneUuid);
+
+    const sceneCheckboxSelector = (scene) => `.scene-checkbox[data-instance="${scene.instance}"][data-scene-uuid="${scene.sceneUuid}"]`;
 
     const identifyLight = async (fqdn) => {
         try {
@@ -137,6 +144,61 @@ $(document).ready(() => {
         }
     };
 
+    // live LED frames relayed by the backend from each light's /leds stream
+    const ledFrames = {};
+
+    const renderLedPreview = (fqdn) => {
+        const $preview = $(`li.configuredLight[data-fqdn="${fqdn}"] .led-preview`);
+        const frame = ledFrames[fqdn];
+        if ($preview.length === 0) {
+            return;
+        }
+        if (!frame) {
+            $preview.text('no data');
+            return;
+        }
+
+        if ($preview.children().length !== frame.leds.length) {
+            $preview.empty();
+            frame.leds.forEach(() => {
+                $preview.append('<span class="led-preview-pixel" style="width: 16px; height: 16px; border: 1px solid #ccc; display: inline-block; vertical-align: middle; margin-right: 2px; border-radius: 50%"></span>');
+            });
+        }
+
+        // scale by the output brightness, so the preview looks like the light
+        $preview.children().each((index, element) => {
+            const color = parseInt(frame.leds[index], 16);
+            const channel = (shift) => Math.round(((color >> shift) & 0xFF) * frame.brightness / 255);
+            element.style.backgroundColor = `rgb(${channel(16)}, ${channel(8)}, ${channel(0)})`;
+        });
+    };
+
+    const ledEvents = new EventSource('/api/leds');
+
+    ledEvents.addEventListener('snapshot', (event) => {
+        Object.assign(ledFrames, JSON.parse(event.data));
+        Object.keys(ledFrames).forEach(renderLedPreview);
+    });
+
+    ledEvents.addEventListener('frame', (event) => {
+        const {fqdn, brightness, leds} = JSON.parse(event.data);
+        ledFrames[fqdn] = {brightness, leds};
+        renderLedPreview(fqdn);
+    });
+
+    ledEvents.addEventListener('delta', (event) => {
+        const {fqdn, brightness, changed} = JSON.parse(event.data);
+        const frame = ledFrames[fqdn];
+        if (!frame) {
+            return;
+        }
+        frame.brightness = brightness;
+        changed.forEach(([index, color]) => {
+            frame.leds[index] = color;
+        });
+        renderLedPreview(fqdn);
+    });
+
     const populateDiscoveredTallylights = (
         lightsFound,
         configuredLights
@@ -210,6 +272,25 @@ $(document).ready(() => {
         }
     };
 
+    // current state and tallylightInfos of a listed configured light
+    const updateLightStatus = ($li, fqdn, currentLightState, tallylightInfos) => {
+        const currentState = currentLightState[fqdn];
+
+        if (currentState) {
+            $li.find('.current-light-state').text(currentState || 'Unknown');
+
+            setColorOfElementToTallylightColor($li, currentState);
+        }
+
+        if (tallylightInfos && fqdn in tallylightInfos) {
+            $li.find('.attr-githash').text(`${tallylightInfos[fqdn].gitHash} (${tallylightInfos[fqdn].gitDirty})`);
+            $li.find('.attr-rssi').text(`${tallylightInfos[fqdn].rssi} dBm`);
+            $li.find('.attr-brightness').text(tallylightInfos[fqdn].brightness);
+            $li.find('.attr-uptime').text(`${(tallylightInfos[fqdn].millis / 1000).toFixed(0)} seconds`);
+            $li.find('.attr-utctime').text(new Date(tallylightInfos[fqdn].utcEpoch * 1000).toISOString());
+        }
+    };
+
     const populateConfiguredTallylights = (
         lightsFound,
         configuredLights,
@@ -263,6 +344,10 @@ $(document).ready(() => {
                                         <span class="current-light-state monospace">${currentLightState[fqdn] || 'Unknown'}</span>
                                         <div class="current-light-color-box" style="width: 32px; height: 32px; background-color: ${currentLightState[fqdn] || '#000'}; border: 1px solid #ccc; display: inline-block; vertical-align: middle; margin-left: 10px; border-radius: 25%"></div>
                                     </div>
+                                    <div class="mb-3">
+                                        <label class="form-label">Live LEDs: </label>
+                                        <span class="led-preview"></span>
+                                    </div>
                                     <div class="mb-3">
                                         <button class="btn btn-sm btn-danger remove-light-btn">Remove</button>
                                         <button class="btn btn-sm btn-secondary identify-light-btn">Identify</button>
@@ -292,13 +377,15 @@ $(document).ready(() => {
                                 <label class="form-label">Scenes</label>
                                 <div class="scenes-list" data-touched="false">
                                     ${obsScenes && obsScenes.length > 0 ? obsScenes.map(scene => {
-                        // scene = { sceneIndex: number, sceneName: string, sceneUuid: string }. the uuid is what will be saved in config
-                        const isChecked = config.visibleInScenes && config.visibleInScenes.includes(scene.sceneUuid) ? 'checked' : '';
+                        // scene = { instance: string, sceneIndex: number, sceneName: string, sceneUuid: string }. instance and uuid are what will be saved in config
+                        const isChecked = isSceneSelected(config, scene) ? 'checked' : '';
+                        const checkboxId = `scene-${fqdn.replace(/\W/g, '_')}-${scene.instance.replace(/\W/g, '_')}-${scene.sceneUuid}`;
+                        const showInstance = obsScenes.some(other => other.instance !== scene.instance);
                         return `
                                             <div class="form-check">
-                                                <input class="form-check-input scene-checkbox" type="checkbox" value="${scene.sceneUuid}" id="scene-${fqdn.replace(/\W/g, '_')}-${scene.sceneUuid}" ${isChecked} data-fqdn="${fqdn}" data-scene-uuid="${scene.sceneUuid}">
-                                                <label class="form-check-label" for="scene-${fqdn.replace(/\W/g, '_')}-${scene.sceneUuid}">
-                                                    ${scene.sceneName}
+                                                <input class="form-check-input scene-checkbox" type="checkbox" value="${scene.sceneUuid}" id="${checkboxId}" ${isChecked} data-fqdn="${fqdn}" data-instance="${scene.instance}" data-scene-uuid="${scene.sceneUuid}">
+                                                <label class="form-check-label" for="${checkboxId}">
+                                                    ${showInstance ? `<span class="text-muted">${scene.instance}:</span> ` : ''}${scene.sceneName}
                                                 </label>
                                             </div>
                                         `;
@@ -311,6 +398,8 @@ $(document).ready(() => {
                     `);
                     $list.append($li);
 
+                    renderLedPreview(fqdn);
+
                     // set initial values
                     $li.find('.brightness-input').val(config.brightness || 0);
                     const currentState = currentLightState[fqdn];
@@ -324,9 +413,9 @@ $(document).ready(() => {
                     // set scenes
                     if (obsScenes && obsScenes.length > 0 && config.visibleInScenes && Array.isArray(config.visibleInScenes)) {
                         obsScenes.forEach(scene => {
-                            const $checkbox = $li.find(`.scene-checkbox[data-scene-uuid="${scene.sceneUuid}"]`);
+                            const $checkbox = $li.find(sceneCheckboxSelector(scene));
                             if ($checkbox.length > 0) {
-                                if (config.visibleInScenes.includes(scene.sceneUuid)) {
+                                if (isSceneSelected(config, scene)) {
                                     $checkbox.prop('checked', true);
                                 } else {
                                     $checkbox.prop('checked', false);
@@ -363,9 +452,13 @@ $(document).ready(() => {
                     });
 
                     $li.find('.save-scenes-btn').on('click', () => {
-                        const selectedScenes = [];
+                        // keep the scenes of instances that are not listed (disconnected), there is no checkbox for them
+                        const listedInstances = new Set(obsScenes.map(scene => scene.instance));
+                        const selectedScenes = (configuredLightsByFqdn[fqdn]?.visibleInScenes || [])
+                            .filter(ref => !listedInstances.has(ref.instance));
                         $li.find('.scene-checkbox:checked').each(function () {
-                            selectedScenes.push($(this).data('scene-uuid'));
+                            // attr, not data: jQuery would turn numeric looking ids into numbers
+                            selectedScenes.push({instance: $(this).attr('data-instance'), sceneUuid: $(this).attr('data-scene-uuid')});
                         });
                         setSceneList(fqdn, selectedScenes);
                     });
@@ -377,37 +470,21 @@ $(document).ready(() => {
                         }
                     });
                 } else {
-                    // update current state and brightness
-                    const currentState = currentLightState[fqdn];
-
-                    if (currentState) {
-                        existing.find('.current-light-state').text(currentState || 'Unknown');
-
-                        setColorOfElementToTallylightColor(existing, currentState);
-                    }
+                    updateLightStatus(existing, fqdn, currentLightState, tallylightInfos);
 
                     const $brightnessInput = existing.find('.brightness-input');
                     if ($brightnessInput[0].dataset.touched !== 'true') {
                         $brightnessInput.val(config.brightness || 0);
                     }
 
-                    // update tallylightInfos if available
-                    if (tallylightInfos && fqdn in tallylightInfos) {
-                        existing.find('.attr-githash').text(`${tallylightInfos[fqdn].gitHash} (${tallylightInfos[fqdn].gitDirty})`);
-                        existing.find('.attr-rssi').text(`${tallylightInfos[fqdn].rssi} dBm`);
-                        existing.find('.attr-brightness').text(tallylightInfos[fqdn].brightness);
-                        existing.find('.attr-uptime').text(`${(tallylightInfos[fqdn].millis / 1000).toFixed(0)} seconds`);
-                        existing.find('.attr-utctime').text(new Date(tallylightInfos[fqdn].utcEpoch * 1000).toISOString());
-                    }
-
                     // update scenes
                     const $scenesList = existing.find('.scenes-list');
                     if ($scenesList[0].dataset.touched !== 'true') {
                         if (obsScenes && obsScenes.length > 0 && config.visibleInScenes && Array.isArray(config.visibleInScenes)) {
                             obsScenes.forEach(scene => {
-                                const $checkbox = existing.find(`.scene-checkbox[data-scene-uuid="${scene.sceneUuid}"]`);
+                                const $checkbox = existing.find(sceneCheckboxSelector(scene));
                                 if ($checkbox.length > 0) {
-                                    if (config.visibleInScenes.includes(scene.sceneUuid)) {
+                                    if (isSceneSelected(config, scene)) {
                                         $checkbox.prop('checked', true);
                                     } else {
                                         $checkbox.prop('checked', false);
@@ -429,7 +506,7 @@ $(document).ready(() => {
         }
     };
 
-    const populateObsStatus = (obsConnected) => {
+    const populateObsStatus = (obsConnected, obsInstances) => {
         const $status = $('#obs-status');
 
         const alertElement = $status.find('.alert');
@@ -441,34 +518,64 @@ $(document).ready(() => {
 
         const statusMessageElement = $status.find('span#obs-status-message');
 
-        if (obsConnected) {
+        if (obsInstances && obsInstances.length > 1) {
+            const disconnected = obsInstances.filter(instance => !instance.connected).map(instance => instance.id);
+            statusMessageElement.text(disconnected.length === 0
+                ? `All ${obsInstances.length} OBS instances are connected.`
+                : `OBS ${disconnected.join(', ')} not connected. Please ensure OBS is running and the WebSocket server is enabled.`);
+            if (disconnected.length > 0) {
+                alertElement.removeClass('alert-success').addClass('alert-danger');
+            }
+        } else if (obsConnected) {
             statusMessageElement.text('OBS is connected.');
         } else {
             statusMessageElement.text('OBS is not connected. Please ensure OBS is running and the WebSocket server is enabled.');
         }
     };
 
-    const fetchApi = async () => {
-        const response = await fetch('/api/data');
+    // the /api/data document, kept current by the deltas from /api/events
+    let data = {};
 
-        const data = await response.json();
-        console.log(data);
+    // JSON merge patch (RFC 7386), as json-patch.ts in the backend produces them
+    const applyMergePatch = (target, patch) => {
+        if (typeof patch !== 'object' || patch === null || Array.isArray(patch)) {
+            return patch;
+        }
+        const result = typeof target === 'object' && target !== null && !Array.isArray(target) ? target : {};
+        Object.entries(patch).forEach(([key, value]) => {
+            if (value === null) {
+                delete result[key];
+            } else {
+                result[key] = applyMergePatch(result[key], value);
+            }
+        });
+        return result;
+    };
 
+    // only the parts that depend on a key of the patch are updated, the whole document counts as a patch too
+    const render = (patch) => {
         // data = {
         //    lightsFound: [...],
+        //    lastPings: {fqdn: date},
         //    scenes: [...],
         //    configuredLights: [...],
         //    currentLightState: {...}
         //    obsConnected: true/false
+        //    obsInstances: [{id, address, connected, ...}]
         //    tallylightInfo: {...}
         // }
+        const changed = (...keys) => keys.some(key => key in patch);
 
         configuredFqdns = data.configuredLights ? Object.keys(data.configuredLights) : [];
+        configuredLightsByFqdn = data.configuredLights || {};
 
         if (data.lightsFound && data.configuredLights) {
-            populateDiscoveredTallylights(data.lightsFound, data.configuredLights);
+            if (changed('lightsFound', 'configuredLights')) {
+                populateDiscoveredTallylights(data.lightsFound, data.configuredLights);
+            }
 
-            if (data.currentLightState && data.scenes && data.tallylightInfos) {
+            if (data.currentLightState && data.scenes && data.tallylightInfos
+                && changed('lightsFound', 'configuredLights', 'scenes')) {
                 populateConfiguredTallylights(
                     data.lightsFound,
                     data.configuredLights,
@@ -476,15 +583,35 @@ $(document).ready(() => {
                     data.scenes,
                     data.tallylightInfos
                 );
+            } else if (data.currentLightState && changed('currentLightState', 'tallylightInfos')) {
+                // only the lights named in the patch
+                const fqdns = new Set([...Object.keys(patch.currentLightState || {}), ...Object.keys(patch.tallylightInfos || {})]);
+                fqdns.forEach(fqdn => {
+                    const $li = $('#configured-lights-list').find(`li.configuredLight[data-fqdn="${fqdn}"]`);
+                    if ($li.length > 0) {
+                        updateLightStatus($li, fqdn, data.currentLightState, data.tallylightInfos);
+                    }
+                });
             }
         }
 
-        if (data.obsConnected !== undefined) {
-            populateObsStatus(data.obsConnected);
+        if (data.obsConnected !== undefined && changed('obsConnected', 'obsInstances')) {
+            populateObsStatus(data.obsConnected, data.obsInstances);
         }
 
         // populate debug info
-        $('#debug').text(JSON.stringify(data, null, 2));
+        if (!$('#debug').hasClass('visually-hidden')) {
+            $('#debug').text(JSON.stringify(data, null, 2));
+        }
+    };
+
+    const fetchApi = async () => {
+        const response = await fetch('/api/data');
+
+        data = await response.json();
+        console.log(data);
+
+        render(data);
     };
 
     const setConfigValue = async (key, value) => {
@@ -619,9 +746,19 @@ $(document).ready(() => {
 
     fetchConfig();
 
-    fetchApi();
+    // a snapshot on (re)connect, then only what changed
+    const dataEvents = new EventSource('/api/events');
 
-    setInterval(fetchApi, 1500);
+    dataEvents.addEventListener('snapshot', (event) => {
+        data = JSON.parse(event.data);
+        render(data);
+    });
+
+    dataEvents.addEventListener('delta', (event) => {
+        const patch = JSON.parse(event.data);
+        applyMergePatch(data, patch);
+        render(patch);
+    });
 
     // toggle visually-hidden class on #debug depending on if search params has debug=true
     const urlParams = new URLSearchParams(window.location.search);
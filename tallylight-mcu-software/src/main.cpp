@@ -8,12 +8,17 @@
 #include <FastLED.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
+#include <AsyncJson.h>
 #include <ArduinoJson.h>
 #include <ArduinoNvs.h>
 #include <NTPClient.h>
 #include <WiFiUdp.h>
 #include <HTTPUpdate.h>
 #include <NetworkClient.h>
+#include <PubSubClient.h>
+#include <AsyncUDP.h>
+#include <mbedtls/md.h>
+#include <esp_timer.h>
 
 #ifndef ESP32
 #error This code is intended to run on the ESP32 platform! Please check your Tools->Board menu.
@@ -35,10 +40,17 @@ constexpr const char baseHostname[] = "Tallylight-";
 #define API_KEY "tallylight" // default, should be overridden in build flags
 #warning "API_KEY not defined, using default 'tallylight'"
 #endif
+#ifndef MQTT_BROKER
+#define MQTT_BROKER "" // empty disables MQTT, should be overridden in build flags
+#endif
 
 // LEDs
 constexpr uint8_t ledstripPin = 5;
 constexpr uint8_t ledCount = 6;
+constexpr uint8_t zoneCount = 3; // groups of adjacent LEDs that can be colored individually
+constexpr uint8_t ledsPerZone = ledCount / zoneCount;
+static_assert(ledCount % zoneCount == 0, "ledCount must be a multiple of zoneCount");
+constexpr uint8_t maxFps = 100; // rate of the render timer
 constexpr uint8_t builtinLed = 2;    // On-board LED pin
 constexpr uint8_t builtinButton = 0; // On-board button pin
 
@@ -68,7 +80,7 @@ constexpr CRGB color_preview = CRGB::Green;
 constexpr CRGB color_error = CRGB::Purple;
 
 
-String toString(TallyState state)
+constexpr const char *toString(TallyState state)
 {
     switch (state)
     {
@@ -87,110 +99,2050 @@ String toString(TallyState state)
     }
 }
 
-std::optional<TallyState> fromString(const String &stateStr)
+std::optional<TallyState> fromString(const String &stateStr)
+{
+    if (stateStr == "OFF")
+        return TALLY_OFF;
+    else if (stateStr == "STANDBY")
+        return TALLY_STANDBY;
+    else if (stateStr == "PROGRAM")
+        return TALLY_PROGRAM;
+    else if (stateStr == "PREVIEW")
+        return TALLY_PREVIEW;
+    else if (stateStr == "ERROR")
+        return TALLY_ERROR;
+    else
+        return std::nullopt;
+}
+
+void populateAllStates(JsonObject &obj)
+{
+    const auto arr = obj["states"].to<JsonArray>();
+    for (uint8_t i = 0; i <= 4; i++)
+    {
+        TallyState state = static_cast<TallyState>(i);
+        JsonObject stateObj = arr.add<JsonObject>();
+        stateObj["id"] = i;
+        stateObj["name"] = toString(state);
+    }
+}
+
+// Setup FastLED
+CRGB leds[ledCount];
+
+// Webserver on port 81
+static AsyncWebServer server(81);
+
+// Time client
+WiFiUDP ntpUDP;
+NTPClient timeClient(ntpUDP, "pool.ntp.org", 0);
+
+// MQTT client, only active if a broker is configured
+constexpr bool mqttEnabled = sizeof(MQTT_BROKER) > 1;
+constexpr uint16_t mqttPort = 1883;
+constexpr uint32_t mqttMinBackoff = 1000;
+constexpr uint32_t mqttMaxBackoff = 30000;
+
+NetworkClient mqttNetworkClient;
+PubSubClient mqtt(mqttNetworkClient);
+String mqttStateTopic;  // tallylight/<hostname>/state, retained by the backend
+String mqttStatusTopic; // tallylight/<hostname>/status, online/offline (last will)
+
+// Function to generate a unique hostname by appending the last 3 bytes of the MAC address
+String generateHostname()
+{
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    char uniquePart[7]; // 6 characters + null terminator
+    snprintf(uniquePart, sizeof(uniquePart), "%02X%02X%02X", mac[3], mac[4], mac[5]);
+    return String(baseHostname) + String(uniquePart);
+}
+
+// DMX input (sACN / Art-Net)
+enum DmxMode : uint8_t
+{
+    DMX_OFF = 0,
+    DMX_TALLY, // one channel selects the tally state, in steps of 10 (0-9 OFF, 10-19 STANDBY, ...)
+    DMX_RGB    // three channels (RGB) per zone, written straight into leds[]
+};
+
+constexpr const char *toString(DmxMode mode)
+{
+    switch (mode)
+    {
+    case DMX_OFF:
+        return "OFF";
+    case DMX_TALLY:
+        return "TALLY";
+    case DMX_RGB:
+        return "RGB";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+std::optional<DmxMode> dmxModeFromString(const String &modeStr)
+{
+    if (modeStr == "OFF")
+        return DMX_OFF;
+    else if (modeStr == "TALLY")
+        return DMX_TALLY;
+    else if (modeStr == "RGB")
+        return DMX_RGB;
+    else
+        return std::nullopt;
+}
+
+// Tally sources, in ascending priority
+enum TallySource : uint8_t
+{
+    SOURCE_BACKEND = 0, // HTTP /set and MQTT, i.e. OBS via the backend
+    SOURCE_OSC,
+    SOURCE_DMX,
+    SOURCE_MANUAL, // always beats every other source
+    SOURCE_COUNT
+};
+
+constexpr const char *toString(TallySource source)
+{
+    switch (source)
+    {
+    case SOURCE_BACKEND:
+        return "BACKEND";
+    case SOURCE_OSC:
+        return "OSC";
+    case SOURCE_DMX:
+        return "DMX";
+    case SOURCE_MANUAL:
+        return "MANUAL";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+std::optional<TallySource> sourceFromString(const String &sourceStr)
+{
+    if (sourceStr == "BACKEND")
+        return SOURCE_BACKEND;
+    else if (sourceStr == "OSC")
+        return SOURCE_OSC;
+    else if (sourceStr == "DMX")
+        return SOURCE_DMX;
+    else if (sourceStr == "MANUAL")
+        return SOURCE_MANUAL;
+    else
+        return std::nullopt;
+}
+
+enum MergePolicy : uint8_t
+{
+    MERGE_STATE = 0, // the most important state of any source wins: PROGRAM > PREVIEW > STANDBY > ERROR > OFF
+    MERGE_SOURCE     // the state of the highest priority source wins
+};
+
+constexpr const char *toString(MergePolicy policy)
+{
+    switch (policy)
+    {
+    case MERGE_STATE:
+        return "STATE";
+    case MERGE_SOURCE:
+        return "SOURCE";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+std::optional<MergePolicy> mergePolicyFromString(const String &policyStr)
+{
+    if (policyStr == "STATE")
+        return MERGE_STATE;
+    else if (policyStr == "SOURCE")
+        return MERGE_SOURCE;
+    else
+        return std::nullopt;
+}
+
+// config
+constexpr uint8_t configVersion = 4;
+
+struct Config
+{
+    uint8_t brightness = std::numeric_limits<uint8_t>::max() / 2;
+    DmxMode dmxMode = DMX_OFF;
+    uint16_t dmxUniverse = 1; // sACN numbering, Art-Net port address is dmxUniverse - 1
+    uint16_t dmxAddress = 1;  // first channel, 1-512
+    MergePolicy mergePolicy = MERGE_STATE;
+    bool standalone = false; // sACN/Art-Net/OSC only, no backend; a missing backend is not an ERROR
+} config;
+
+// layouts of older versions, for the migration
+struct ConfigV1
+{
+    uint8_t brightness;
+};
+
+struct ConfigV2
+{
+    uint8_t brightness;
+    DmxMode dmxMode;
+    uint16_t dmxUniverse;
+    uint16_t dmxAddress;
+};
+
+struct ConfigV3
+{
+    uint8_t brightness;
+    DmxMode dmxMode;
+    uint16_t dmxUniverse;
+    uint16_t dmxAddress;
+    MergePolicy mergePolicy;
+};
+
+// copies the fields an older blob has, everything added since keeps its default
+bool migrateConfig(int64_t version)
+{
+    switch (version)
+    {
+    case 1:
+    {
+        ConfigV1 old;
+        if (!NVS.getBlob("config", (uint8_t *)&old, sizeof(old)))
+            return false;
+        config.brightness = old.brightness;
+        return true;
+    }
+    case 2:
+    {
+        ConfigV2 old;
+        if (!NVS.getBlob("config", (uint8_t *)&old, sizeof(old)))
+            return false;
+        config.brightness = old.brightness;
+        config.dmxMode = old.dmxMode;
+        config.dmxUniverse = old.dmxUniverse;
+        config.dmxAddress = old.dmxAddress;
+        return true;
+    }
+    case 3:
+    {
+        ConfigV3 old;
+        if (!NVS.getBlob("config", (uint8_t *)&old, sizeof(old)))
+            return false;
+        config.brightness = old.brightness;
+        config.dmxMode = old.dmxMode;
+        config.dmxUniverse = old.dmxUniverse;
+        config.dmxAddress = old.dmxAddress;
+        config.mergePolicy = old.mergePolicy;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void saveConfig()
+{
+    NVS.setInt("configVersion", configVersion);
+    NVS.setBlob("config", (uint8_t *)&config, sizeof(config));
+    NVS.commit();
+    Serial.println("Config saved");
+}
+
+void loadConfig()
+{
+    const auto version = NVS.getInt("configVersion", 0);
+    if (version != configVersion)
+    {
+        if (migrateConfig(version))
+        {
+            Serial.printf("Config migrated from version %d\n", static_cast<int>(version));
+        }
+        else
+        {
+            config = Config();
+            Serial.println("No valid config found, using defaults");
+        }
+        saveConfig();
+        return;
+    }
+
+    // read config as blob
+    bool success = NVS.getBlob("config", (uint8_t *)&config, sizeof(config));
+    if (!success)
+    {
+        Serial.println("Failed to read config, using defaults");
+        config = Config();
+        saveConfig();
+    }
+    else
+    {
+        Serial.println("Config loaded");
+    }
+}
+
+// Every source writes its own slot, tallyState is the merged result. The per-state source bitmasks
+// make recomputing the merge constant time, it runs on every input event.
+constexpr uint32_t backendLease = 25000; // renewed by /ping, the backend pings every 10 seconds
+
+struct SourceSlot
+{
+    TallyState state;
+    uint32_t leaseStart; // millis() of the last set or renewal
+    uint32_t lease;      // ms, 0 if the slot does not expire
+};
+
+// unsigned difference, so the lease survives the millis() wrap after 49.7 days
+uint32_t leaseRemaining(const SourceSlot &slot, uint32_t now)
+{
+    const uint32_t elapsed = now - slot.leaseStart;
+    return elapsed < slot.lease ? slot.lease - elapsed : 0;
+}
+
+SourceSlot sourceSlots[SOURCE_COUNT] = {};
+uint8_t activeSources = 0;                    // bit per source
+uint8_t sourcesInState[TALLY_ERROR + 1] = {}; // bit per source, for each state
+
+portMUX_TYPE sourcesMux = portMUX_INITIALIZER_UNLOCKED;
+
+constexpr TallyState stateRanking[] = {TALLY_PROGRAM, TALLY_PREVIEW, TALLY_STANDBY, TALLY_ERROR, TALLY_OFF};
+
+// must be called with sourcesMux held
+void mergeSourceStates()
+{
+    if (activeSources & (1 << SOURCE_MANUAL))
+    {
+        tallyState = sourceSlots[SOURCE_MANUAL].state;
+        return;
+    }
+
+    if (activeSources == 0)
+    {
+        tallyState = TALLY_OFF;
+        return;
+    }
+
+    if (config.mergePolicy == MERGE_SOURCE)
+    {
+        tallyState = sourceSlots[31 - __builtin_clz(activeSources)].state;
+        return;
+    }
+
+    for (const TallyState state : stateRanking)
+    {
+        if (sourcesInState[state])
+        {
+            tallyState = state;
+            return;
+        }
+    }
+}
+
+// must be called with sourcesMux held
+void clearSourceSlot(TallySource source)
+{
+    const uint8_t bit = 1 << source;
+    if (activeSources & bit)
+    {
+        sourcesInState[sourceSlots[source].state] &= ~bit;
+        activeSources &= ~bit;
+    }
+}
+
+// lease in ms, 0 keeps the state until it is changed or released
+void setSourceState(TallySource source, TallyState state, uint32_t lease)
+{
+    const uint8_t bit = 1 << source;
+
+    portENTER_CRITICAL(&sourcesMux);
+    clearSourceSlot(source);
+    sourceSlots[source].state = state;
+    sourceSlots[source].leaseStart = millis();
+    sourceSlots[source].lease = lease;
+    sourcesInState[state] |= bit;
+    activeSources |= bit;
+    mergeSourceStates();
+    portEXIT_CRITICAL(&sourcesMux);
+}
+
+void renewSourceLease(TallySource source, uint32_t lease)
+{
+    portENTER_CRITICAL(&sourcesMux);
+    if (activeSources & (1 << source))
+    {
+        sourceSlots[source].leaseStart = millis();
+        sourceSlots[source].lease = lease;
+    }
+    portEXIT_CRITICAL(&sourcesMux);
+}
+
+void releaseSource(TallySource source)
+{
+    portENTER_CRITICAL(&sourcesMux);
+    clearSourceSlot(source);
+    mergeSourceStates();
+    portEXIT_CRITICAL(&sourcesMux);
+}
+
+void setMergePolicy(MergePolicy policy)
+{
+    portENTER_CRITICAL(&sourcesMux);
+    config.mergePolicy = policy;
+    mergeSourceStates();
+    portEXIT_CRITICAL(&sourcesMux);
+}
+
+// An expired backend lease turns into ERROR (the backend is gone), every other source is released
+void expireSourceLeases()
+{
+    const uint32_t now = millis();
+    bool backendExpired = false;
+
+    portENTER_CRITICAL(&sourcesMux);
+    for (uint8_t i = 0; i < SOURCE_COUNT; i++)
+    {
+        const auto source = static_cast<TallySource>(i);
+        SourceSlot &slot = sourceSlots[source];
+        if (!(activeSources & (1 << source)) || slot.lease == 0 || leaseRemaining(slot, now) > 0)
+            continue;
+
+        clearSourceSlot(source);
+        if (source == SOURCE_BACKEND)
+        {
+            backendExpired = true;
+            slot.state = TALLY_ERROR;
+            slot.lease = 0;
+            sourcesInState[TALLY_ERROR] |= 1 << source;
+            activeSources |= 1 << source;
+        }
+    }
+    mergeSourceStates();
+    portEXIT_CRITICAL(&sourcesMux);
+
+    if (backendExpired)
+    {
+        Serial.println("No ping received for 25 seconds, going to error state");
+    }
+}
+
+void populateSources(JsonObject &obj)
+{
+    const uint32_t now = millis();
+    const auto arr = obj["sources"].to<JsonArray>();
+    for (uint8_t i = 0; i < SOURCE_COUNT; i++)
+    {
+        const auto source = static_cast<TallySource>(i);
+        const SourceSlot slot = sourceSlots[source];
+        JsonObject sourceObj = arr.add<JsonObject>();
+        sourceObj["name"] = toString(source);
+        sourceObj["active"] = (activeSources & (1 << source)) != 0;
+        sourceObj["state"] = toString(slot.state);
+        sourceObj["leaseMs"] = slot.lease ? leaseRemaining(slot, now) : 0;
+    }
+}
+
+uint64_t lastMqttAttempt = 0;
+
+uint32_t mqttBackoff = mqttMinBackoff;
+
+// loop() takes its render snapshot under this lock, hold it to apply several changes within one frame
+portMUX_TYPE renderMux = portMUX_INITIALIZER_UNLOCKED;
+
+// written from the network tasks, 64 bit so only under renderMux
+uint64_t identifyStart = 0;
+
+uint64_t lastOtaTime = 0;
+
+bool otaInProgress = false;
+
+bool hasTriedOta = false;
+
+bool lastWiFiConnected = true;
+
+uint64_t configSaveDue = 0; // under renderMux, like identifyStart
+
+constexpr uint32_t identifyMaxSeconds = 3600;
+
+void startIdentify(uint32_t durationMs)
+{
+    portENTER_CRITICAL(&renderMux);
+    identifyStart = durationMs ? millis() + durationMs : 0;
+    portEXIT_CRITICAL(&renderMux);
+}
+
+void scheduleConfigSave(uint32_t delayMs)
+{
+    portENTER_CRITICAL(&renderMux);
+    configSaveDue = millis() + delayMs;
+    portEXIT_CRITICAL(&renderMux);
+}
+
+// true once when a scheduled save is due, for loop()
+bool takeConfigSaveDue()
+{
+    portENTER_CRITICAL(&renderMux);
+    const bool due = configSaveDue != 0 && millis() > configSaveDue;
+    if (due)
+        configSaveDue = 0;
+    portEXIT_CRITICAL(&renderMux);
+    return due;
+}
+
+void setBrightness(uint8_t brightness)
+{
+    if (brightness != config.brightness)
+    {
+        config.brightness = brightness;
+        scheduleConfigSave(2000); // saved from loop(), faders send a stream of values
+    }
+}
+
+// Per-zone color overrides, drawn on top of the tally state
+struct ZoneOverride
+{
+    bool active;
+    CRGB color;
+};
+
+ZoneOverride zoneOverrides[zoneCount] = {};
+
+// Payload: {"state": "PROGRAM", "brightness": 128, "identify": true}, every key is optional
+void onMqttMessage(char *topic, byte *payload, unsigned int length)
+{
+    // the backend deletes the retained state of a removed light with an empty message
+    if (length == 0)
+    {
+        return;
+    }
+
+    JsonDocument doc;
+    if (deserializeJson(doc, payload, length))
+    {
+        Serial.printf("Invalid MQTT payload on %s\n", topic);
+        return;
+    }
+
+    renewSourceLease(SOURCE_BACKEND, backendLease);
+
+    if (doc["state"].is<const char *>())
+    {
+        auto stateValue = fromString(doc["state"].as<const char *>());
+        if (stateValue)
+        {
+            setSourceState(SOURCE_BACKEND, stateValue.value(), backendLease);
+        }
+        else
+        {
+            Serial.printf("Invalid state on %s\n", topic);
+        }
+    }
+
+    if (doc["brightness"].is<uint8_t>())
+    {
+        setBrightness(doc["brightness"].as<uint8_t>());
+    }
+
+    if (doc["identify"] | false)
+    {
+        startIdentify(5000);
+    }
+}
+
+void mqttLoop()
+{
+    if (!mqttEnabled)
+        return;
+
+    if (mqtt.connected())
+    {
+        mqtt.loop();
+        return;
+    }
+
+    if (lastMqttAttempt != 0 && millis() - lastMqttAttempt < mqttBackoff)
+        return;
+
+    lastMqttAttempt = millis();
+
+    // clean session: the retained state topic is re-delivered on every subscribe, so nothing queued
+    // on the broker while we were away is worth replaying
+    if (mqtt.connect(WiFi.getHostname(), nullptr, nullptr, mqttStatusTopic.c_str(), 1, true, "offline", true))
+    {
+        Serial.println("Connected to MQTT broker");
+        mqtt.publish(mqttStatusTopic.c_str(), "online", true);
+
+        // the retained state is delivered right away, so a reconnecting light catches up
+        mqtt.subscribe(mqttStateTopic.c_str(), 1);
+        mqttBackoff = mqttMinBackoff;
+    }
+    else
+    {
+        Serial.printf("MQTT connect failed (%d), retrying in %u ms\n", mqtt.state(), mqttBackoff);
+        mqttBackoff = std::min(mqttBackoff * 2, mqttMaxBackoff);
+    }
+}
+
+// DMX input. Both receivers run in the AsyncUDP task and parse the packet in place, slot data goes
+// straight from the packet buffer into leds[] (RGB mode) or the DMX source slot (TALLY mode).
+constexpr uint16_t sacnPort = 5568;
+constexpr uint16_t artnetPort = 6454;
+constexpr uint32_t dmxSourceTimeout = 2500; // E1.31 network data loss timeout
+constexpr uint8_t artnetPriority = 100;     // Art-Net has no priority, treat it like the sACN default
+
+AsyncUDP sacnUdp;
+AsyncUDP artnetUdp;
+
+// The DMX receiver writes into dmxLeds, the render task copies it into leds[] under dmxLedsMux. leds[] itself is
+// only touched by the renderer, so FastLED.show() never sends a half written frame.
+portMUX_TYPE dmxLedsMux = portMUX_INITIALIZER_UNLOCKED;
+CRGB dmxLeds[ledCount];
+
+struct DmxSource
+{
+    uint8_t cid[16]; // sACN component id, or the sender IP for Art-Net
+    uint8_t priority;
+    uint8_t sequence;
+    uint32_t lastSeen; // millis(), 0 if no source
+} dmxSource = {};
+
+volatile uint32_t dmxLastRgbFrame = 0;
+volatile uint32_t dmxPackets = 0;
+volatile uint32_t dmxDropped = 0;
+
+bool dmxListenPending = true;
+
+// Only the highest priority source is used (no HTP merge), a lower or equal priority source can take
+// over once the current one has timed out or terminated its stream.
+bool acceptDmxSource(const uint8_t *cid, uint8_t priority, uint8_t sequence, bool sequenced)
+{
+    const uint32_t now = millis();
+    const bool sourceActive = dmxSource.lastSeen != 0 && now - dmxSource.lastSeen < dmxSourceTimeout;
+
+    if (memcmp(dmxSource.cid, cid, sizeof(dmxSource.cid)) != 0)
+    {
+        if (sourceActive && priority <= dmxSource.priority)
+            return false;
+
+        memcpy(dmxSource.cid, cid, sizeof(dmxSource.cid));
+    }
+    else if (sequenced && sourceActive)
+    {
+        // E1.31 6.7.2: discard out of order packets, but resync after a large jump (e.g. sender restart)
+        const int8_t diff = static_cast<int8_t>(sequence - dmxSource.sequence);
+        if (diff <= 0 && diff > -20)
+        {
+            dmxDropped++;
+            return false;
+        }
+    }
+
+    dmxSource.priority = priority;
+    dmxSource.sequence = sequence;
+    dmxSource.lastSeen = now;
+    return true;
+}
+
+// slots[0] is DMX channel 1
+void applyDmxSlots(const uint8_t *slots, uint16_t slotCount)
+{
+    const uint16_t start = config.dmxAddress - 1;
+
+    if (config.dmxMode == DMX_TALLY)
+    {
+        if (start >= slotCount)
+            return;
+
+        const uint8_t state = slots[start] / 10;
+        if (state <= TALLY_ERROR)
+        {
+            setSourceState(SOURCE_DMX, static_cast<TallyState>(state), dmxSourceTimeout);
+        }
+    }
+    else if (config.dmxMode == DMX_RGB)
+    {
+        if (start + zoneCount * 3 > slotCount)
+            return;
+
+        const uint8_t *rgb = slots + start;
+
+        portENTER_CRITICAL(&dmxLedsMux);
+        if constexpr (ledsPerZone == 1)
+        {
+            static_assert(sizeof(CRGB) == 3, "CRGB must be packed RGB");
+            memcpy(dmxLeds, rgb, sizeof(dmxLeds));
+        }
+        else
+        {
+            for (uint8_t zone = 0; zone < zoneCount; zone++)
+            {
+                fill_solid(dmxLeds + zone * ledsPerZone, ledsPerZone, CRGB(rgb[zone * 3], rgb[zone * 3 + 1], rgb[zone * 3 + 2]));
+            }
+        }
+        portEXIT_CRITICAL(&dmxLedsMux);
+
+        dmxLastRgbFrame = millis();
+    }
+}
+
+void onSacnPacket(AsyncUDPPacket &packet)
+{
+    static constexpr uint8_t acnPacketIdentifier[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+
+    const uint8_t *data = packet.data();
+    const size_t length = packet.length();
+
+    if (length < 126 || memcmp(data + 4, acnPacketIdentifier, sizeof(acnPacketIdentifier)) != 0)
+        return;
+
+    // root vector VECTOR_ROOT_E131_DATA, framing vector VECTOR_E131_DATA_PACKET, DMP vector and start code 0
+    if (data[21] != 0x04 || data[43] != 0x02 || data[117] != 0x02 || data[125] != 0x00)
+        return;
+
+    const uint16_t universe = (data[113] << 8) | data[114];
+    if (universe != config.dmxUniverse)
+        return;
+
+    const uint8_t options = data[112];
+    if (options & 0x80) // preview data, not meant for live output
+        return;
+
+    if (options & 0x40) // stream terminated
+    {
+        if (memcmp(dmxSource.cid, data + 22, sizeof(dmxSource.cid)) == 0)
+            dmxSource.lastSeen = 0;
+        return;
+    }
+
+    if (!acceptDmxSource(data + 22, data[108], data[111], true))
+        return;
+
+    dmxPackets++;
+
+    const uint16_t propertyCount = (data[123] << 8) | data[124];
+    const uint16_t slotCount = std::min<size_t>(propertyCount > 0 ? propertyCount - 1 : 0, length - 126);
+    applyDmxSlots(data + 126, slotCount);
+}
+
+void onArtnetPacket(AsyncUDPPacket &packet)
+{
+    static constexpr uint8_t artnetId[8] = {'A', 'r', 't', '-', 'N', 'e', 't', 0};
+
+    const uint8_t *data = packet.data();
+    const size_t length = packet.length();
+
+    // OpDmx (0x5000, little endian)
+    if (length < 18 || memcmp(data, artnetId, sizeof(artnetId)) != 0 || data[8] != 0x00 || data[9] != 0x50)
+        return;
+
+    const uint16_t portAddress = ((data[15] & 0x7F) << 8) | data[14];
+    if (portAddress + 1 != config.dmxUniverse)
+        return;
+
+    uint8_t cid[16] = {};
+    const uint32_t ip = packet.remoteIP();
+    memcpy(cid, &ip, sizeof(ip));
+
+    const uint8_t sequence = data[12];
+    if (!acceptDmxSource(cid, artnetPriority, sequence, sequence != 0))
+        return;
+
+    dmxPackets++;
+
+    const uint16_t slotCount = std::min<size_t>((data[16] << 8) | data[17], length - 18);
+    applyDmxSlots(data + 18, slotCount);
+}
+
+void dmxListen()
+{
+    sacnUdp.close();
+    artnetUdp.close();
+    dmxSource = {};
+
+    if (config.dmxMode == DMX_OFF)
+        return;
+
+    const IPAddress sacnGroup(239, 255, config.dmxUniverse >> 8, config.dmxUniverse & 0xFF);
+    if (sacnUdp.listenMulticast(sacnGroup, sacnPort))
+    {
+        sacnUdp.onPacket(onSacnPacket);
+    }
+    else
+    {
+        Serial.println("Failed to listen for sACN");
+    }
+
+    if (artnetUdp.listen(artnetPort))
+    {
+        artnetUdp.onPacket(onArtnetPacket);
+    }
+    else
+    {
+        Serial.println("Failed to listen for Art-Net");
+    }
+
+    Serial.printf("DMX input %s on universe %u, address %u\n", toString(config.dmxMode), config.dmxUniverse, config.dmxAddress);
+}
+
+// OSC input. Messages are decoded in place in the AsyncUDP buffer, nothing is allocated per packet.
+//   /tally/state      s "PROGRAM" | i 2
+//   /tally/brightness i 0-255 | f 0.0-1.0
+//   /tally/identify   [i|f seconds, default 5] | T | F (stop)
+//   /tally/release    hand the light back to the other sources
+// Incoming address patterns (?, *, [a-z], [!a], {a,b}) are matched against these addresses.
+constexpr uint16_t oscPort = 8000;
+constexpr uint8_t oscMaxBundleDepth = 4;
+
+AsyncUDP oscUdp;
+
+volatile uint32_t oscPackets = 0;
+volatile uint32_t oscMessages = 0;
+volatile uint32_t oscErrors = 0;
+
+struct OscArgument
+{
+    char type; // 0 if there is no argument
+    int32_t i;
+    float f;
+    const char *s;
+};
+
+// OSC strings are null terminated and padded to 4 bytes, returns nullptr if malformed
+const uint8_t *oscSkipString(const uint8_t *data, const uint8_t *end)
+{
+    const uint8_t *terminator = static_cast<const uint8_t *>(memchr(data, 0, end - data));
+    if (!terminator)
+        return nullptr;
+
+    const size_t padded = ((terminator - data) + 4) & ~size_t(3);
+    return padded <= size_t(end - data) ? data + padded : nullptr;
+}
+
+int32_t oscReadInt32(const uint8_t *data)
+{
+    return static_cast<int32_t>((uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3]);
+}
+
+bool oscMatchBracket(const char *&pattern, char c)
+{
+    pattern++; // [
+    const bool negate = *pattern == '!';
+    if (negate)
+        pattern++;
+
+    bool matched = false;
+    while (*pattern && *pattern != ']')
+    {
+        if (pattern[1] == '-' && pattern[2] && pattern[2] != ']')
+        {
+            if (c >= pattern[0] && c <= pattern[2])
+                matched = true;
+            pattern += 3;
+        }
+        else
+        {
+            if (c == *pattern)
+                matched = true;
+            pattern++;
+        }
+    }
+    if (*pattern == ']')
+        pattern++;
+
+    return matched != negate;
+}
+
+// patterns come from unauthenticated packets, anything longer or wilder than our method table needs is rejected
+constexpr size_t oscMaxPatternLength = 64;
+constexpr uint8_t oscMaxWildcards = 4;
+
+bool oscPatternAllowed(const char *pattern)
+{
+    uint8_t wildcards = 0;
+    size_t length = 0;
+    for (; pattern[length]; length++)
+    {
+        if (length >= oscMaxPatternLength)
+            return false;
+        const char c = pattern[length];
+        if ((c == '*' || c == '?' || c == '[' || c == '{') && ++wildcards > oscMaxWildcards)
+            return false;
+    }
+    return true;
+}
+
+// OSC 1.0 address pattern matching, no wildcard matches across '/'. A '*' is retried from the last star only,
+// so there is no recursion per candidate; '{}' recurses once per alternative, bounded by oscMaxWildcards.
+bool oscMatch(const char *pattern, const char *address)
+{
+    const char *starPattern = nullptr; // after the last '*'
+    const char *starAddress = nullptr; // where that star's match ends so far
+
+    while (*address || *pattern)
+    {
+        if (*pattern == '*')
+        {
+            while (*pattern == '*')
+                pattern++;
+            starPattern = pattern;
+            starAddress = address;
+            continue;
+        }
+
+        bool matched = false;
+        switch (*pattern)
+        {
+        case 0:
+            break;
+        case '?':
+            if (*address && *address != '/')
+            {
+                pattern++;
+                address++;
+                matched = true;
+            }
+            break;
+        case '[':
+        {
+            const char *next = pattern;
+            if (*address && *address != '/' && oscMatchBracket(next, *address))
+            {
+                pattern = next;
+                address++;
+                matched = true;
+            }
+            break;
+        }
+        case '{':
+        {
+            const char *close = strchr(pattern, '}');
+            if (!close)
+                return false;
+
+            const char *alternative = pattern + 1;
+            while (alternative < close)
+            {
+                const char *comma = static_cast<const char *>(memchr(alternative, ',', close - alternative));
+                const char *alternativeEnd = comma ? comma : close;
+                const size_t length = alternativeEnd - alternative;
+                if (strncmp(alternative, address, length) == 0 && oscMatch(close + 1, address + length))
+                    return true;
+                alternative = alternativeEnd + 1;
+            }
+            break; // the rest was tried with every alternative, only a longer star match can help
+        }
+        default:
+            if (*pattern == *address)
+            {
+                pattern++;
+                address++;
+                matched = true;
+            }
+            break;
+        }
+
+        if (matched)
+            continue;
+
+        // let the last star take one more character, it never takes a '/'
+        if (!starPattern || !*starAddress || *starAddress == '/')
+            return false;
+        pattern = starPattern;
+        address = ++starAddress;
+    }
+
+    return true;
+}
+
+void onOscState(const OscArgument &arg)
+{
+    std::optional<TallyState> state;
+    if (arg.type == 's')
+        state = fromString(arg.s);
+    else if (arg.type == 'i' && arg.i >= TALLY_OFF && arg.i <= TALLY_ERROR)
+        state = static_cast<TallyState>(arg.i);
+
+    if (!state)
+    {
+        oscErrors++;
+        return;
+    }
+
+    setSourceState(SOURCE_OSC, state.value(), 0);
+}
+
+void onOscBrightness(const OscArgument &arg)
+{
+    if (arg.type == 'i' && arg.i >= 0 && arg.i <= 255)
+        setBrightness(static_cast<uint8_t>(arg.i));
+    else if (arg.type == 'f' && arg.f >= 0.0f && arg.f <= 1.0f)
+        setBrightness(static_cast<uint8_t>(arg.f * 255.0f + 0.5f));
+    else
+        oscErrors++;
+}
+
+void onOscIdentify(const OscArgument &arg)
+{
+    // seconds, clamped before the conversion to ms so large arguments don't overflow
+    uint32_t duration = 5000;
+    if (arg.type == 'i' && arg.i > 0)
+        duration = std::min<uint32_t>(arg.i, identifyMaxSeconds) * 1000;
+    else if (arg.type == 'f' && arg.f > 0.0f)
+        duration = std::min(arg.f, static_cast<float>(identifyMaxSeconds)) * 1000.0f;
+    else if (arg.type == 'F')
+        duration = 0;
+
+    startIdentify(duration);
+}
+
+void onOscRelease(const OscArgument &)
+{
+    releaseSource(SOURCE_OSC);
+}
+
+struct OscMethod
+{
+    const char *address;
+    void (*handler)(const OscArgument &);
+};
+
+constexpr OscMethod oscMethods[] = {
+    {"/tally/state", onOscState},
+    {"/tally/brightness", onOscBrightness},
+    {"/tally/identify", onOscIdentify},
+    {"/tally/release", onOscRelease},
+};
+
+void handleOscMessage(const uint8_t *data, const uint8_t *end)
+{
+    const char *address = reinterpret_cast<const char *>(data);
+    const uint8_t *typeTags = oscSkipString(data, end);
+    if (!typeTags || *address != '/')
+    {
+        oscErrors++;
+        return;
+    }
+
+    // only the first argument is used by any method
+    OscArgument arg = {};
+    const uint8_t *args = typeTags < end ? oscSkipString(typeTags, end) : nullptr;
+    if (args && typeTags[0] == ',' && typeTags[1] != 0)
+    {
+        arg.type = typeTags[1];
+        switch (arg.type)
+        {
+        case 'i':
+        case 'f':
+            if (end - args < 4)
+            {
+                oscErrors++;
+                return;
+            }
+            arg.i = oscReadInt32(args);
+            memcpy(&arg.f, &arg.i, sizeof(arg.f));
+            break;
+        case 's':
+            if (!oscSkipString(args, end))
+            {
+                oscErrors++;
+                return;
+            }
+            arg.s = reinterpret_cast<const char *>(args);
+            break;
+        default:
+            break; // T, F and anything without payload
+        }
+    }
+
+    oscMessages++;
+
+    if (!oscPatternAllowed(address))
+    {
+        oscErrors++;
+        return;
+    }
+
+    for (const auto &method : oscMethods)
+    {
+        if (oscMatch(address, method.address))
+            method.handler(arg);
+    }
+}
+
+void handleOscPacket(const uint8_t *data, const uint8_t *end, uint8_t depth)
+{
+    static constexpr char bundleId[8] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0};
+
+    if (end - data < 8 || memcmp(data, bundleId, sizeof(bundleId)) != 0)
+    {
+        handleOscMessage(data, end);
+        return;
+    }
+
+    // bundle: id, 8 byte time tag (ignored, everything is applied immediately), then size-prefixed elements
+    if (depth >= oscMaxBundleDepth || end - data < 16)
+    {
+        oscErrors++;
+        return;
+    }
+
+    for (const uint8_t *element = data + 16; element + 4 <= end;)
+    {
+        const int32_t size = oscReadInt32(element);
+        element += 4;
+        if (size <= 0 || size > end - element)
+        {
+            oscErrors++;
+            return;
+        }
+        handleOscPacket(element, element + size, depth + 1);
+        element += size;
+    }
+}
+
+void onOscPacket(AsyncUDPPacket &packet)
+{
+    oscPackets++;
+    handleOscPacket(packet.data(), packet.data() + packet.length(), 0);
+}
+
+// Authenticated binary command frames, over UDP and the /ws WebSocket. All integers big endian.
+//   0  2  magic "TL"
+//   2  1  version
+//   3  1  command, replies set the top bit
+//   4  8  nonce, upper 32 bits UTC epoch seconds, lower 32 bits a sender counter
+//   12 1  payload length n
+//   13 n  payload
+//   +n 8  HMAC-SHA256(API_KEY, bytes 0 .. 13 + n), truncated
+// Nonces have to increase and be within frameMaxClockSkew of our NTP time, which bounds replays to one
+// use and also covers reboots. Replies carry [status, tallyState, brightness] and are signed the same way.
+constexpr uint16_t frameUdpPort = 8001;
+constexpr uint8_t frameVersion = 1;
+constexpr size_t frameHeaderSize = 13;
+constexpr size_t frameMacSize = 8;
+constexpr size_t frameMaxSize = frameHeaderSize + 255 + frameMacSize;
+constexpr uint32_t frameMaxClockSkew = 30; // seconds
+
+enum FrameCommand : uint8_t
+{
+    FRAME_SET = 0x01,        // state, [brightness]
+    FRAME_BRIGHTNESS = 0x02, // brightness
+    FRAME_IDENTIFY = 0x03,   // seconds, 0 stops
+    FRAME_PING = 0x04,
+    FRAME_REPLY = 0x80
+};
+
+enum FrameStatus : uint8_t
+{
+    FRAME_OK = 0,
+    FRAME_REPLAYED,
+    FRAME_STALE, // clock skew or our time is not set yet, the sender falls back to HTTP
+    FRAME_INVALID_PAYLOAD,
+    FRAME_UNKNOWN_COMMAND
+};
+
+// HMAC-SHA256 on the mbedtls SHA peripheral driver. The key is absorbed once, every frame only
+// resets the inner state. One instance per task, the context is not thread safe.
+class FrameAuthenticator
+{
+public:
+    void begin(const char *key)
+    {
+        mbedtls_md_init(&ctx);
+        mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
+        mbedtls_md_hmac_starts(&ctx, reinterpret_cast<const uint8_t *>(key), strlen(key));
+    }
+
+    void sign(const uint8_t *data, size_t length, uint8_t *mac)
+    {
+        uint8_t digest[32];
+        mbedtls_md_hmac_reset(&ctx);
+        mbedtls_md_hmac_update(&ctx, data, length);
+        mbedtls_md_hmac_finish(&ctx, digest);
+        memcpy(mac, digest, frameMacSize);
+    }
+
+    bool verify(const uint8_t *data, size_t length, const uint8_t *mac)
+    {
+        uint8_t expected[frameMacSize];
+        sign(data, length, expected);
+
+        uint8_t diff = 0;
+        for (size_t i = 0; i < frameMacSize; i++)
+            diff |= expected[i] ^ mac[i];
+        return diff == 0;
+    }
+
+private:
+    mbedtls_md_context_t ctx;
+};
+
+FrameAuthenticator udpFrameAuth;
+FrameAuthenticator wsFrameAuth;
+
+AsyncUDP frameUdp;
+AsyncWebSocket frameWs("/ws");
+
+portMUX_TYPE frameNonceMux = portMUX_INITIALIZER_UNLOCKED;
+uint64_t lastFrameNonce = 0;
+bool frameNonceFloorSet = false;
+
+// updated from the AsyncUDP and async_tcp tasks
+portMUX_TYPE frameStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+struct FrameStats
+{
+    uint32_t received;
+    uint32_t accepted;
+    uint32_t badMac;
+    uint32_t rejected; // replayed, stale or invalid
+    uint32_t verifyCount;
+    uint64_t verifyTotalUs;
+    uint32_t verifyMaxUs;
+} frameStats = {};
+
+void countFrame(uint32_t FrameStats::*counter)
+{
+    portENTER_CRITICAL(&frameStatsMux);
+    frameStats.*counter += 1;
+    portEXIT_CRITICAL(&frameStatsMux);
+}
+
+void recordFrameVerify(uint32_t verifyUs)
+{
+    portENTER_CRITICAL(&frameStatsMux);
+    frameStats.verifyCount++;
+    frameStats.verifyTotalUs += verifyUs;
+    frameStats.verifyMaxUs = std::max(frameStats.verifyMaxUs, verifyUs);
+    portEXIT_CRITICAL(&frameStatsMux);
+}
+
+// NTP time for renderTask and the network tasks. NTPClient is not safe to read while loop() updates it, so loop()
+// hands over the epoch of each successful update together with the millis() it was taken at.
+uint32_t ntpEpoch = 0;
+uint32_t ntpEpochMillis = 0;
+
+void captureNtpEpoch()
+{
+    const uint32_t epoch = timeClient.getEpochTime();
+    const uint32_t now = millis();
+    portENTER_CRITICAL(&renderMux);
+    ntpEpoch = epoch;
+    ntpEpochMillis = now;
+    portEXIT_CRITICAL(&renderMux);
+}
+
+// the current epoch from that snapshot, false until the first NTP update
+bool currentEpoch(uint32_t &epoch)
+{
+    portENTER_CRITICAL(&renderMux);
+    const bool set = ntpEpoch != 0;
+    epoch = ntpEpoch + (millis() - ntpEpochMillis) / 1000;
+    portEXIT_CRITICAL(&renderMux);
+    return set;
+}
+
+uint64_t readUint64(const uint8_t *data)
+{
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < 8; i++)
+        value = (value << 8) | data[i];
+    return value;
+}
+
+FrameStatus checkFrameNonce(uint64_t nonce)
+{
+    // the nonce counter starts from scratch after a reboot, without the time there is no floor against replays
+    uint32_t epoch;
+    if (!currentEpoch(epoch))
+        return FRAME_STALE;
+
+    const int64_t skew = static_cast<int64_t>(nonce >> 32) - static_cast<int64_t>(epoch);
+    if (skew > frameMaxClockSkew || skew < -static_cast<int64_t>(frameMaxClockSkew))
+        return FRAME_STALE;
+
+    FrameStatus status = FRAME_OK;
+    portENTER_CRITICAL(&frameNonceMux);
+    if (!frameNonceFloorSet)
+    {
+        // nothing sent before we booted may be replayed, the counter starts from scratch after a reboot
+        frameNonceFloorSet = true;
+        lastFrameNonce = std::max(lastFrameNonce, static_cast<uint64_t>(epoch + 1) << 32);
+    }
+    if (nonce <= lastFrameNonce)
+        status = FRAME_REPLAYED;
+    else
+        lastFrameNonce = nonce;
+    portEXIT_CRITICAL(&frameNonceMux);
+
+    return status;
+}
+
+FrameStatus executeFrame(uint8_t command, const uint8_t *payload, uint8_t length)
+{
+    switch (command)
+    {
+    case FRAME_SET:
+        if (length < 1 || payload[0] > TALLY_ERROR)
+            return FRAME_INVALID_PAYLOAD;
+        setSourceState(SOURCE_BACKEND, static_cast<TallyState>(payload[0]), backendLease);
+        if (length >= 2)
+            setBrightness(payload[1]);
+        return FRAME_OK;
+    case FRAME_BRIGHTNESS:
+        if (length < 1)
+            return FRAME_INVALID_PAYLOAD;
+        setBrightness(payload[0]);
+        return FRAME_OK;
+    case FRAME_IDENTIFY:
+        if (length < 1)
+            return FRAME_INVALID_PAYLOAD;
+        startIdentify(payload[0] * 1000);
+        return FRAME_OK;
+    case FRAME_PING:
+        renewSourceLease(SOURCE_BACKEND, backendLease);
+        return FRAME_OK;
+    default:
+        return FRAME_UNKNOWN_COMMAND;
+    }
+}
+
+// returns the reply length, 0 if the frame is dropped without reply
+size_t handleFrame(FrameAuthenticator &auth, const uint8_t *data, size_t length, uint8_t *reply)
+{
+    countFrame(&FrameStats::received);
+
+    if (length < frameHeaderSize + frameMacSize || data[0] != 'T' || data[1] != 'L' || data[2] != frameVersion ||
+        (data[3] & FRAME_REPLY) || data[12] != length - frameHeaderSize - frameMacSize)
+    {
+        countFrame(&FrameStats::rejected);
+        return 0;
+    }
+
+    const size_t signedLength = length - frameMacSize;
+
+    const int64_t verifyStart = esp_timer_get_time();
+    const bool authentic = auth.verify(data, signedLength, data + signedLength);
+    const uint32_t verifyUs = esp_timer_get_time() - verifyStart;
+    recordFrameVerify(verifyUs);
+
+    if (!authentic)
+    {
+        countFrame(&FrameStats::badMac);
+        return 0;
+    }
+
+    const uint64_t nonce = readUint64(data + 4);
+    FrameStatus status = checkFrameNonce(nonce);
+    if (status == FRAME_OK)
+        status = executeFrame(data[3], data + frameHeaderSize, data[12]);
+
+    countFrame(status == FRAME_OK ? &FrameStats::accepted : &FrameStats::rejected);
+
+    memcpy(reply, data, 12); // magic, version, command and nonce
+    reply[3] |= FRAME_REPLY;
+    reply[12] = 3;
+    reply[13] = status;
+    reply[14] = tallyState;
+    reply[15] = config.brightness;
+    auth.sign(reply, 16, reply + 16);
+    return 16 + frameMacSize;
+}
+
+void onFramePacket(AsyncUDPPacket &packet)
+{
+    uint8_t reply[frameHeaderSize + 3 + frameMacSize];
+    const size_t replyLength = handleFrame(udpFrameAuth, packet.data(), packet.length(), reply);
+    if (replyLength)
+        packet.write(reply, replyLength);
+}
+
+void onFrameWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+    if (type != WS_EVT_DATA)
+        return;
+
+    // one frame per (unfragmented) binary message
+    const AwsFrameInfo *info = static_cast<AwsFrameInfo *>(arg);
+    if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_BINARY || len > frameMaxSize)
+        return;
+
+    uint8_t reply[frameHeaderSize + 3 + frameMacSize];
+    const size_t replyLength = handleFrame(wsFrameAuth, data, len, reply);
+    if (replyLength)
+        client->binary(reply, replyLength);
+}
+
+// Request limiting, so a misbehaving client cannot starve loop(). Rejections happen before the handler
+// runs, i.e. without any JSON work. WebSocket upgrades are not limited, they would never leave "in flight".
+constexpr uint8_t rateLimitClients = 8; // tracked client IPs, the least recently seen one is evicted
+constexpr float rateLimitPerSecond = 20.0f;
+constexpr float rateLimitBurst = 40.0f;
+constexpr uint8_t maxRequestsInFlight = 8;
+
+struct ClientBucket
+{
+    uint32_t ip;
+    float tokens;
+    uint32_t lastSeen; // millis(), 0 if unused
+};
+
+ClientBucket clientBuckets[rateLimitClients] = {};
+
+// only touched from the AsyncTCP task
+uint8_t requestsInFlight = 0;
+uint32_t rateLimitedRequests = 0;
+uint32_t overloadedRequests = 0;
+
+bool takeRequestToken(uint32_t ip)
+{
+    const uint32_t now = millis();
+
+    ClientBucket *bucket = nullptr;
+    ClientBucket *oldest = &clientBuckets[0];
+    for (auto &candidate : clientBuckets)
+    {
+        if (candidate.lastSeen != 0 && candidate.ip == ip)
+        {
+            bucket = &candidate;
+            break;
+        }
+        if (candidate.lastSeen < oldest->lastSeen)
+            oldest = &candidate;
+    }
+
+    if (!bucket)
+    {
+        // A free slot, or one idle long enough to have refilled, starts full. Evicting an active client starts
+        // empty, otherwise rotating through more IPs than there are slots would get a fresh burst every time.
+        const bool idle = oldest->lastSeen == 0 || now - oldest->lastSeen >= rateLimitBurst * 1000.0f / rateLimitPerSecond;
+        bucket = oldest;
+        bucket->ip = ip;
+        bucket->tokens = idle ? rateLimitBurst : 0.0f;
+        bucket->lastSeen = now;
+    }
+
+    bucket->tokens = std::min(rateLimitBurst, bucket->tokens + (now - bucket->lastSeen) * rateLimitPerSecond / 1000.0f);
+    bucket->lastSeen = now;
+
+    if (bucket->tokens < 1.0f)
+        return false;
+
+    bucket->tokens -= 1.0f;
+    return true;
+}
+
+void limitRequest(AsyncWebServerRequest *request, ArMiddlewareNext next)
+{
+    if (!takeRequestToken(request->client()->remoteIP()))
+    {
+        rateLimitedRequests++;
+        request->send(429);
+        return;
+    }
+
+    if (requestsInFlight >= maxRequestsInFlight)
+    {
+        overloadedRequests++;
+        request->send(503);
+        return;
+    }
+
+    requestsInFlight++;
+    request->onDisconnect([]()
+                          { requestsInFlight--; });
+    next();
+}
+
+AsyncMiddlewareFunction requestLimiter(limitRequest);
+
+// Live mirror of leds[] at /leds (server-sent events), so the control room sees what is actually lit. A client
+// gets a full frame on connect and every keyframe interval, deltas with only the changed LEDs in between. Changes
+// are coalesced to mirrorMaxRate events per second and held back while the clients' queues are backed up.
+//   event "frame": {"b":255,"leds":"FF0000FF0000..."}   output brightness and every LED as RRGGBB
+//   event "delta": {"b":255,"d":[[0,"00FF00"],...]}      output brightness and changed LEDs
+constexpr uint8_t mirrorMaxRate = 10;
+constexpr uint32_t mirrorKeyframeInterval = 5000;
+constexpr uint8_t mirrorMaxClients = 4;
+constexpr uint32_t mirrorMaxQueued = 4; // average events waiting per client
+constexpr size_t mirrorEventSize = 32 + ledCount * 15;
+
+AsyncEventSource ledEvents("/leds");
+portMUX_TYPE mirrorMux = portMUX_INITIALIZER_UNLOCKED;
+// What the clients have seen. Written by whoever holds renderLock (renderTask, or loop() while rendering is
+// suspended for OTA), always under mirrorMux; onMirrorConnect on the async_tcp task copies it under mirrorMux too.
+CRGB mirroredLeds[ledCount];
+uint8_t mirroredBrightness = 0;
+uint32_t lastMirrorEvent = 0;
+uint32_t lastMirrorKeyframe = 0;
+uint32_t mirrorEventId = 0;
+uint32_t mirrorEventsHeldBack = 0;
+
+size_t formatMirrorFrame(char *buffer, const CRGB *frame, uint8_t brightness)
+{
+    size_t length = snprintf(buffer, mirrorEventSize, "{\"b\":%u,\"leds\":\"", brightness);
+    for (uint8_t i = 0; i < ledCount; i++)
+        length += snprintf(buffer + length, mirrorEventSize - length, "%02X%02X%02X", frame[i].r, frame[i].g, frame[i].b);
+    length += snprintf(buffer + length, mirrorEventSize - length, "\"}");
+    return length;
+}
+
+void onMirrorConnect(AsyncEventSourceClient *client)
+{
+    if (ledEvents.count() > mirrorMaxClients)
+    {
+        client->close();
+        return;
+    }
+
+    CRGB frame[ledCount];
+    portENTER_CRITICAL(&mirrorMux);
+    memcpy(frame, mirroredLeds, sizeof(frame));
+    const uint8_t brightness = mirroredBrightness;
+    portEXIT_CRITICAL(&mirrorMux);
+
+    char buffer[mirrorEventSize];
+    formatMirrorFrame(buffer, frame, brightness);
+    client->send(buffer, "frame", mirrorEventId, 1000);
+}
+
+void mirrorLeds()
+{
+    const uint32_t now = millis();
+    if (now - lastMirrorEvent < 1000 / mirrorMaxRate)
+        return;
+
+    const uint8_t brightness = FastLED.getBrightness();
+    const bool keyframe = now - lastMirrorKeyframe >= mirrorKeyframeInterval;
+    const bool changed = brightness != mirroredBrightness || memcmp(leds, mirroredLeds, sizeof(leds)) != 0;
+    if (!changed && !keyframe)
+        return;
+
+    if (ledEvents.count() == 0)
+    {
+        // nobody watching, just keep the snapshot for the next client current
+        portENTER_CRITICAL(&mirrorMux);
+        memcpy(mirroredLeds, leds, sizeof(leds));
+        mirroredBrightness = brightness;
+        portEXIT_CRITICAL(&mirrorMux);
+        return;
+    }
+
+    if (ledEvents.avgPacketsWaiting() > mirrorMaxQueued)
+    {
+        // the snapshot is left alone, so the next delta still contains everything that changed
+        mirrorEventsHeldBack++;
+        return;
+    }
+
+    char buffer[mirrorEventSize];
+    if (keyframe)
+    {
+        formatMirrorFrame(buffer, leds, brightness);
+        lastMirrorKeyframe = now;
+    }
+    else
+    {
+        size_t length = snprintf(buffer, sizeof(buffer), "{\"b\":%u,\"d\":[", brightness);
+        bool first = true;
+        for (uint8_t i = 0; i < ledCount; i++)
+        {
+            if (leds[i] == mirroredLeds[i])
+                continue;
+            length += snprintf(buffer + length, sizeof(buffer) - length, "%s[%u,\"%02X%02X%02X\"]", first ? "" : ",", i, leds[i].r, leds[i].g, leds[i].b);
+            first = false;
+        }
+        snprintf(buffer + length, sizeof(buffer) - length, "]}");
+    }
+
+    portENTER_CRITICAL(&mirrorMux);
+    memcpy(mirroredLeds, leds, sizeof(leds));
+    mirroredBrightness = brightness;
+    portEXIT_CRITICAL(&mirrorMux);
+
+    ledEvents.send(buffer, keyframe ? "frame" : "delta", ++mirrorEventId);
+    lastMirrorEvent = now;
+}
+
+// Render timing. An esp_timer fires every frame period and wakes renderTask, which draws the frame due at that
+// deadline, so stalls in loop() (WiFiManager, NTP, MQTT) no longer shift the animations. The histogram holds
+// how late each frame reached the strip compared to its deadline.
+constexpr uint32_t framePeriodUs = 1000000 / maxFps;
+constexpr uint32_t renderBucketLimitsUs[] = {250, 500, 1000, 2000, 5000, 10000}; // plus one bucket for everything above
+constexpr size_t renderBucketCount = sizeof(renderBucketLimitsUs) / sizeof(renderBucketLimitsUs[0]) + 1;
+
+esp_timer_handle_t renderTimer = nullptr;
+TaskHandle_t renderTaskHandle = nullptr;
+SemaphoreHandle_t renderLock = nullptr; // held by renderTask while it draws a frame
+volatile bool renderSuspended = false;  // loop() owns leds[] (WiFi lost, OTA)
+int64_t renderTimerStart = 0;
+
+uint32_t renderLatenessHistogram[renderBucketCount] = {};
+uint32_t renderMaxLatenessUs = 0;
+uint32_t renderFrames = 0;
+uint32_t renderMissedFrames = 0;
+
+void showFrame(int64_t deadlineUs)
+{
+    const int64_t lateness = esp_timer_get_time() - deadlineUs;
+    const uint32_t latenessUs = lateness > 0 ? lateness : 0;
+    size_t bucket = 0;
+    while (bucket < renderBucketCount - 1 && latenessUs > renderBucketLimitsUs[bucket])
+        bucket++;
+    renderLatenessHistogram[bucket]++;
+    renderMaxLatenessUs = std::max(renderMaxLatenessUs, latenessUs);
+    renderFrames++;
+
+    FastLED.show();
+    mirrorLeds();
+}
+
+// stops renderTask after the frame it may be drawing, loop() can then draw on its own
+void suspendRendering()
+{
+    renderSuspended = true;
+    xSemaphoreTake(renderLock, portMAX_DELAY);
+    xSemaphoreGive(renderLock);
+}
+
+void resumeRendering()
+{
+    renderSuspended = false;
+}
+
+void populateRenderStats(JsonObject &obj)
+{
+    JsonObject render = obj["render"].to<JsonObject>();
+    render["framePeriodUs"] = framePeriodUs;
+    render["frames"] = renderFrames;
+    render["missedFrames"] = renderMissedFrames;
+    render["maxLatenessUs"] = renderMaxLatenessUs;
+
+    JsonArray buckets = render["lateness"].to<JsonArray>();
+    for (size_t i = 0; i < renderBucketCount; i++)
+    {
+        JsonObject bucket = buckets.add<JsonObject>();
+        if (i < renderBucketCount - 1)
+            bucket["leUs"] = renderBucketLimitsUs[i];
+        else
+            bucket["leUs"] = "inf";
+        bucket["count"] = renderLatenessHistogram[i];
+    }
+
+    JsonObject mirror = obj["mirror"].to<JsonObject>();
+    mirror["clients"] = ledEvents.count();
+    mirror["events"] = mirrorEventId;
+    mirror["heldBack"] = mirrorEventsHeldBack;
+}
+
+// Batch of operations, POST /batch?apiKey=... with {"ops": [...]}. Every op is validated before any is
+// applied, then all of them are applied under renderMux so they show up in the same frame.
+//   {"op": "state", "state": "PROGRAM", ["source": "MANUAL"], ["lease": seconds]}
+//   {"op": "release", ["source": "MANUAL"]}
+//   {"op": "brightness", "value": 0-255}
+//   {"op": "identify", ["seconds": 5]}              0 stops identifying
+//   {"op": "zone", "zone": 0, "color": "#FF0000"}   null color removes the override
+//   {"op": "mergePolicy", "policy": "STATE"}
+constexpr size_t maxBatchOps = 16;
+
+enum BatchOpType : uint8_t
+{
+    BATCH_STATE,
+    BATCH_RELEASE,
+    BATCH_BRIGHTNESS,
+    BATCH_IDENTIFY,
+    BATCH_ZONE,
+    BATCH_MERGE_POLICY
+};
+
+struct BatchOp
+{
+    BatchOpType type;
+    TallySource source;
+    TallyState state;
+    MergePolicy policy;
+    uint8_t zone;
+    bool active;
+    CRGB color;
+    uint32_t value; // brightness, lease or identify duration in ms
+};
+
+// returns an error message, or nullptr if the op is valid
+const char *parseBatchOp(JsonObjectConst obj, BatchOp &op)
+{
+    const String type = obj["op"] | "";
+
+    op.source = SOURCE_BACKEND;
+    if (obj["source"].is<const char *>())
+    {
+        auto source = sourceFromString(obj["source"].as<const char *>());
+        if (!source)
+            return "Invalid source value";
+        op.source = source.value();
+    }
+
+    if (type == "state")
+    {
+        auto state = fromString(obj["state"] | "");
+        if (!state)
+            return "Invalid state value";
+        const int lease = obj["lease"] | (op.source == SOURCE_BACKEND ? static_cast<int>(backendLease / 1000) : 0);
+        if (lease < 0 || lease > 86400)
+            return "Invalid lease value";
+        op.type = BATCH_STATE;
+        op.state = state.value();
+        op.value = lease * 1000;
+    }
+    else if (type == "release")
+    {
+        op.type = BATCH_RELEASE;
+    }
+    else if (type == "brightness")
+    {
+        if (!obj["value"].is<uint8_t>())
+            return "Invalid brightness value";
+        op.type = BATCH_BRIGHTNESS;
+        op.value = obj["value"].as<uint8_t>();
+    }
+    else if (type == "identify")
+    {
+        const int seconds = obj["seconds"] | 5;
+        if (seconds < 0 || seconds > 3600)
+            return "Invalid identify duration";
+        op.type = BATCH_IDENTIFY;
+        op.value = seconds * 1000;
+    }
+    else if (type == "zone")
+    {
+        const int zone = obj["zone"] | -1;
+        if (zone < 0 || zone >= zoneCount)
+            return "Invalid zone";
+        op.type = BATCH_ZONE;
+        op.zone = zone;
+        op.active = !obj["color"].isNull();
+        if (op.active)
+        {
+            const char *color = obj["color"] | "";
+            char *end = nullptr;
+            if (color[0] != '#' || strlen(color) != 7)
+                return "Invalid zone color, expected #RRGGBB";
+            const uint32_t rgb = strtoul(color + 1, &end, 16);
+            if (*end != 0)
+                return "Invalid zone color, expected #RRGGBB";
+            op.color = CRGB(rgb);
+        }
+    }
+    else if (type == "mergePolicy")
+    {
+        auto policy = mergePolicyFromString(obj["policy"] | "");
+        if (!policy)
+            return "Invalid mergePolicy value";
+        op.type = BATCH_MERGE_POLICY;
+        op.policy = policy.value();
+    }
+    else
+    {
+        return "Unknown op";
+    }
+
+    return nullptr;
+}
+
+// must be called with renderMux held, must not touch flash
+void applyBatchOp(const BatchOp &op)
+{
+    switch (op.type)
+    {
+    case BATCH_STATE:
+        setSourceState(op.source, op.state, op.value);
+        break;
+    case BATCH_RELEASE:
+        releaseSource(op.source);
+        break;
+    case BATCH_BRIGHTNESS:
+        setBrightness(op.value);
+        break;
+    case BATCH_IDENTIFY:
+        startIdentify(op.value);
+        break;
+    case BATCH_ZONE:
+        zoneOverrides[op.zone].active = op.active;
+        zoneOverrides[op.zone].color = op.color;
+        break;
+    case BATCH_MERGE_POLICY:
+        if (op.policy != config.mergePolicy)
+        {
+            setMergePolicy(op.policy);
+            scheduleConfigSave(0);
+        }
+        break;
+    }
+}
+
+// constant time, so the key cannot be guessed byte by byte from response times
+bool checkApiKey(AsyncWebServerRequest *request)
 {
-    if (stateStr == "OFF")
-        return TALLY_OFF;
-    else if (stateStr == "STANDBY")
-        return TALLY_STANDBY;
-    else if (stateStr == "PROGRAM")
-        return TALLY_PROGRAM;
-    else if (stateStr == "PREVIEW")
-        return TALLY_PREVIEW;
-    else if (stateStr == "ERROR")
-        return TALLY_ERROR;
-    else
-        return std::nullopt;
+    static constexpr char apiKey[] = API_KEY;
+
+    if (!request->hasParam("apiKey"))
+        return false;
+
+    const String &value = request->getParam("apiKey")->value();
+    uint8_t diff = value.length() != sizeof(apiKey) - 1;
+    for (size_t i = 0; i < sizeof(apiKey) - 1; i++)
+        diff |= apiKey[i] ^ (i < value.length() ? value[i] : 0);
+    return diff == 0;
 }
 
-void populateAllStates(JsonObject &obj)
+void handleBatch(AsyncWebServerRequest *request, JsonVariant &json)
 {
-    const auto arr = obj["states"].to<JsonArray>();
-    for (uint8_t i = 0; i <= 4; i++)
+    if (!checkApiKey(request))
     {
-        TallyState state = static_cast<TallyState>(i);
-        JsonObject stateObj = arr.add<JsonObject>();
-        stateObj["id"] = i;
-        stateObj["name"] = toString(state);
+        request->send(403, "application/json", "{\"error\":\"Invalid API key\", \"success\": false}");
+        return;
     }
-}
 
-// Setup FastLED
-CRGB leds[ledCount];
+    JsonArrayConst ops = json["ops"].as<JsonArrayConst>();
+    if (ops.isNull() || ops.size() == 0 || ops.size() > maxBatchOps)
+    {
+        request->send(400, "application/json", "{\"error\":\"Expected 1 to 16 ops\", \"success\": false}");
+        return;
+    }
 
-// Webserver on port 81
-static AsyncWebServer server(81);
+    BatchOp parsed[maxBatchOps];
+    size_t count = 0;
+    for (JsonObjectConst obj : ops)
+    {
+        const char *error = parseBatchOp(obj, parsed[count]);
+        if (error)
+        {
+            JsonDocument errorDoc;
+            errorDoc["success"] = false;
+            errorDoc["error"] = error;
+            errorDoc["index"] = count;
+            request->send(400, "application/json", errorDoc.as<String>());
+            return;
+        }
+        count++;
+    }
 
-// Time client
-WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP, "pool.ntp.org", 0);
+    renewSourceLease(SOURCE_BACKEND, backendLease);
 
-// Function to generate a unique hostname by appending the last 3 bytes of the MAC address
-String generateHostname()
-{
-    uint8_t mac[6];
-    WiFi.macAddress(mac);
-    char uniquePart[7]; // 6 characters + null terminator
-    snprintf(uniquePart, sizeof(uniquePart), "%02X%02X%02X", mac[3], mac[4], mac[5]);
-    return String(baseHostname) + String(uniquePart);
+    portENTER_CRITICAL(&renderMux);
+    for (size_t i = 0; i < count; i++)
+        applyBatchOp(parsed[i]);
+    portEXIT_CRITICAL(&renderMux);
+
+    JsonDocument responseDoc;
+    responseDoc["success"] = true;
+    responseDoc["applied"] = count;
+    responseDoc["tallyState"] = toString(tallyState);
+    responseDoc["brightness"] = config.brightness;
+    JsonArray zones = responseDoc["zones"].to<JsonArray>();
+    for (const auto &zone : zoneOverrides)
+    {
+        if (zone.active)
+        {
+            char color[8];
+            snprintf(color, sizeof(color), "#%02X%02X%02X", zone.color.r, zone.color.g, zone.color.b);
+            zones.add(color);
+        }
+        else
+        {
+            zones.add(nullptr);
+        }
+    }
+    request->send(200, "application/json", responseDoc.as<String>());
 }
 
-// config
-constexpr uint8_t configVersion = 1;
+// Capability document served at /capabilities. It only depends on the build, so it is assembled at compile
+// time; clients cache it per gitHash. Bump capabilitiesVersion on incompatible changes to its layout.
+constexpr uint8_t capabilitiesVersion = 1;
 
-struct Config
+template <size_t N>
+struct ConstexprString
 {
-    uint8_t brightness = std::numeric_limits<uint8_t>::max() / 2;
-} config;
+    char data[N] = {};
+    size_t length = 0;
 
-void saveConfig()
+    constexpr ConstexprString &operator<<(const char *str)
+    {
+        while (*str && length < N - 1)
+            data[length++] = *str++;
+        return *this;
+    }
+
+    constexpr ConstexprString &operator<<(uint32_t value)
+    {
+        char digits[10] = {};
+        size_t count = 0;
+        do
+        {
+            digits[count++] = '0' + value % 10;
+            value /= 10;
+        } while (value);
+        while (count && length < N - 1)
+            data[length++] = digits[--count];
+        return *this;
+    }
+};
+
+constexpr auto buildCapabilities()
 {
-    NVS.setInt("configVersion", configVersion);
-    NVS.setBlob("config", (uint8_t *)&config, sizeof(config));
-    NVS.commit();
-    Serial.println("Config saved");
+    ConstexprString<768> doc;
+    doc << "{\"v\":" << capabilitiesVersion << ",\"gitHash\":\"" << GIT_HASH << "\"";
+
+    doc << ",\"protocols\":[\"http\",\"batch\",\"udp-frame\",\"ws-frame\",\"osc\",\"sacn\",\"artnet\"";
+    if (mqttEnabled)
+        doc << ",\"mqtt\"";
+    doc << "]";
+
+    doc << ",\"ports\":{\"http\":81,\"udp-frame\":" << frameUdpPort << ",\"osc\":" << oscPort
+        << ",\"sacn\":" << sacnPort << ",\"artnet\":" << artnetPort;
+    if (mqttEnabled)
+        doc << ",\"mqtt\":" << mqttPort;
+    doc << "}";
+
+    doc << ",\"states\":[";
+    for (uint8_t i = 0; i <= TALLY_ERROR; i++)
+        doc << (i ? ",\"" : "\"") << toString(static_cast<TallyState>(i)) << "\"";
+    doc << "]";
+
+    doc << ",\"sources\":[";
+    for (uint8_t i = 0; i < SOURCE_COUNT; i++)
+        doc << (i ? ",\"" : "\"") << toString(static_cast<TallySource>(i)) << "\"";
+    doc << "]";
+
+    doc << ",\"ledCount\":" << ledCount << ",\"zones\":" << zoneCount << ",\"maxFps\":" << maxFps
+        << ",\"maxBatchOps\":" << maxBatchOps;
+
+    doc << ",\"features\":[\"arbitration\",\"zones\",\"rateLimit\",\"identify\"]}";
+    return doc;
 }
 
-void loadConfig()
+constexpr auto capabilities = buildCapabilities();
+static_assert(capabilities.length < sizeof(capabilities.data) - 1, "capability document truncated");
+
+// draws the frame due at deadlineUs, blink phases are derived from the deadline and not from when we got to run
+void renderFrame(int64_t deadlineUs)
 {
-    const auto version = NVS.getInt("configVersion", 0);
-    if (version != configVersion)
+    const uint32_t frameMillis = deadlineUs / 1000;
+
+    // snapshot everything the frame depends on, so a batch shows up in one frame
+    portENTER_CRITICAL(&renderMux);
+    if (identifyStart != 0 && frameMillis > identifyStart)
     {
-        Serial.println("No valid config found, using defaults");
-        saveConfig();
+        identifyStart = 0; // stop identifying
+    }
+    const bool identifying = identifyStart != 0;
+    const TallyState state = tallyState;
+    const uint8_t brightness = config.brightness;
+    ZoneOverride zones[zoneCount];
+    memcpy(zones, zoneOverrides, sizeof(zones));
+    const uint32_t epoch = ntpEpoch + static_cast<int32_t>(frameMillis - ntpEpochMillis) / 1000;
+    portEXIT_CRITICAL(&renderMux);
+
+    if (identifying)
+    {
+        // blink blue
+        fill_solid(leds, ledCount, frameMillis % 500 < 250 ? color_identify : color_off);
+        FastLED.setBrightness(255);
+        showFrame(deadlineUs);
         return;
     }
 
-    // read config as blob
-    bool success = NVS.getBlob("config", (uint8_t *)&config, sizeof(config));
-    if (!success)
+    if (config.dmxMode == DMX_RGB && dmxLastRgbFrame != 0 && millis() - dmxLastRgbFrame < dmxSourceTimeout)
     {
-        Serial.println("Failed to read config, using defaults");
-        config = Config();
-        saveConfig();
+        // the desk controls the colors and the intensity
+        portENTER_CRITICAL(&dmxLedsMux);
+        memcpy(leds, dmxLeds, sizeof(leds));
+        portEXIT_CRITICAL(&dmxLedsMux);
+        FastLED.setBrightness(255);
+        showFrame(deadlineUs);
+        return;
     }
-    else
+
+    // display current tally state
+    switch (state)
     {
-        Serial.println("Config loaded");
+    case TALLY_OFF:
+        fill_solid(leds, ledCount, color_off);
+        break;
+    case TALLY_STANDBY:
+        fill_solid(leds, ledCount, color_standby);
+        break;
+    case TALLY_PROGRAM:
+        fill_solid(leds, ledCount, color_program);
+        break;
+    case TALLY_PREVIEW:
+        fill_solid(leds, ledCount, color_preview);
+        break;
+    case TALLY_ERROR:
+        // on the epoch second, so all lights blink in sync
+        fill_solid(leds, ledCount, epoch % 2 < 1 ? color_error : color_off);
+        break;
+    default:
+        fill_solid(leds, ledCount, color_off);
+        Serial.printf("Unknown tally state: %d\n", state);
+        break;
     }
-}
 
-uint64_t lastPing = 1;
+    for (uint8_t zone = 0; zone < zoneCount; zone++)
+    {
+        if (zones[zone].active)
+        {
+            fill_solid(leds + zone * ledsPerZone, ledsPerZone, zones[zone].color);
+        }
+    }
 
-uint64_t identifyStart = 0;
+    if (brightness != FastLED.getBrightness())
+    {
+        FastLED.setBrightness(brightness);
+    }
 
-uint64_t lastOtaTime = 0;
+    showFrame(deadlineUs);
+}
 
-bool otaInProgress = false;
+void onRenderTimer(void *)
+{
+    xTaskNotifyGive(renderTaskHandle);
+}
 
-bool hasTriedOta = false;
+void renderTask(void *)
+{
+    uint32_t frameIndex = 0;
+    for (;;)
+    {
+        // more than one notification means we were too slow and frames were dropped
+        const uint32_t due = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        frameIndex += due;
+        renderMissedFrames += due - 1;
+
+        xSemaphoreTake(renderLock, portMAX_DELAY);
+        if (!renderSuspended)
+            renderFrame(renderTimerStart + static_cast<int64_t>(frameIndex) * framePeriodUs);
+        xSemaphoreGive(renderLock);
+    }
+}
 
-bool lastWiFiConnected = true;
+void startRendering()
+{
+    renderLock = xSemaphoreCreateMutex();
+    // above loop() so network handling cannot delay a frame
+    xTaskCreatePinnedToCore(renderTask, "render", 4096, nullptr, 2, &renderTaskHandle, ARDUINO_RUNNING_CORE);
+
+    const esp_timer_create_args_t timerArgs = {
+        .callback = onRenderTimer,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "render",
+        .skip_unhandled_events = false,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &renderTimer));
+    renderTimerStart = esp_timer_get_time();
+    ESP_ERROR_CHECK(esp_timer_start_periodic(renderTimer, framePeriodUs));
+}
 
 void setup()
 {
-    tallyState = TALLY_OFF;
-
     pinMode(builtinLed, OUTPUT);
     digitalWrite(builtinLed, HIGH); // Turn on during boot
 
@@ -198,6 +2150,12 @@ void setup()
 
     loadConfig();
 
+    // ERROR if the backend does not show up within its lease, unless the light runs without one
+    if (!config.standalone)
+    {
+        setSourceState(SOURCE_BACKEND, TALLY_OFF, backendLease);
+    }
+
     // Initialize FastLED
     FastLED.addLeds<WS2812B, ledstripPin, GRB>(leds, ledCount);
     FastLED.setBrightness(config.brightness);
@@ -276,7 +2234,46 @@ void setup()
                 root["brightness"] = config.brightness;
                 root["millis"] = millis();
                 root["rssi"] = WiFi.RSSI();
-                root["utcEpoch"] = timeClient.getEpochTime();
+                uint32_t epoch = 0;
+                currentEpoch(epoch);
+                root["utcEpoch"] = epoch;
+                root["mergePolicy"] = toString(config.mergePolicy);
+                root["standalone"] = config.standalone;
+
+                populateSources(root);
+
+                JsonObject requests = root["requests"].to<JsonObject>();
+                requests["inFlight"] = requestsInFlight;
+                requests["rateLimited"] = rateLimitedRequests;
+                requests["overloaded"] = overloadedRequests;
+
+                populateRenderStats(root);
+
+                JsonObject dmx = root["dmx"].to<JsonObject>();
+                dmx["mode"] = toString(config.dmxMode);
+                dmx["universe"] = config.dmxUniverse;
+                dmx["address"] = config.dmxAddress;
+                dmx["packets"] = dmxPackets;
+                dmx["dropped"] = dmxDropped;
+
+                portENTER_CRITICAL(&frameStatsMux);
+                const FrameStats frameSnapshot = frameStats;
+                portEXIT_CRITICAL(&frameStatsMux);
+
+                JsonObject frames = root["frames"].to<JsonObject>();
+                frames["port"] = frameUdpPort;
+                frames["received"] = frameSnapshot.received;
+                frames["accepted"] = frameSnapshot.accepted;
+                frames["badMac"] = frameSnapshot.badMac;
+                frames["rejected"] = frameSnapshot.rejected;
+                frames["verifyAvgUs"] = frameSnapshot.verifyCount ? frameSnapshot.verifyTotalUs / frameSnapshot.verifyCount : 0;
+                frames["verifyMaxUs"] = frameSnapshot.verifyMaxUs;
+
+                JsonObject osc = root["osc"].to<JsonObject>();
+                osc["port"] = oscPort;
+                osc["packets"] = oscPackets;
+                osc["messages"] = oscMessages;
+                osc["errors"] = oscErrors;
 
                 populateAllStates(root);
 
@@ -287,14 +2284,15 @@ void setup()
                     request->send(500, "application/json", "{\"error\":\"Failed to serialize JSON\"}");
                     return;
                 }
-                request->send(200, "application/json", response); });
+                request->send(200, "application/json", response); })
+        .addMiddleware(&requestLimiter);
 
     server.on("/set", HTTP_GET, [](AsyncWebServerRequest *request)
               {
                   bool noAction = true;
 
                   // validate api key
-                  if (!request->hasParam("apiKey") || request->getParam("apiKey")->value() != API_KEY)
+                  if (!checkApiKey(request))
                   {
                       request->send(403, "application/json", "{\"error\":\"Invalid API key\", \"success\": false}");
                       return;
@@ -309,7 +2307,33 @@ void setup()
         return;                                                                                                    \
     }
 
-                  lastPing = millis();
+                  TallySource source = SOURCE_BACKEND;
+                  if (request->hasParam("source"))
+                  {
+                      auto sourceValue = sourceFromString(request->getParam("source")->value());
+                      if (!sourceValue)
+                      {
+                          SEND_ERROR("Invalid source value");
+                      }
+                      source = sourceValue.value();
+                  }
+
+                  // lease in seconds, 0 keeps the state until it is changed or released
+                  uint32_t lease = source == SOURCE_BACKEND ? backendLease : 0;
+                  if (request->hasParam("lease"))
+                  {
+                      int leaseSeconds = request->getParam("lease")->value().toInt();
+                      if (leaseSeconds < 0 || leaseSeconds > 86400)
+                      {
+                          SEND_ERROR("Invalid lease value");
+                      }
+                      lease = leaseSeconds * 1000;
+                  }
+
+                  if (source == SOURCE_BACKEND)
+                  {
+                      renewSourceLease(SOURCE_BACKEND, backendLease);
+                  }
 
                   if (request->hasParam("state"))
                   {
@@ -320,13 +2344,49 @@ void setup()
 
                       if (stateValue)
                       {
-                          tallyState = static_cast<TallyState>(stateValue.value());
+                          setSourceState(source, stateValue.value(), lease);
                       }
                       else
                       {
                           SEND_ERROR("Invalid state value");
                       }
                   }
+                  else if (request->hasParam("release"))
+                  {
+                      noAction = false;
+                      releaseSource(source);
+                  }
+
+                  if (request->hasParam("mergePolicy"))
+                  {
+                      noAction = false;
+                      auto policy = mergePolicyFromString(request->getParam("mergePolicy")->value());
+                      if (!policy)
+                      {
+                          SEND_ERROR("Invalid mergePolicy value");
+                      }
+                      if (policy.value() != config.mergePolicy)
+                      {
+                          setMergePolicy(policy.value());
+                          saveConfig();
+                      }
+                  }
+
+                  if (request->hasParam("standalone"))
+                  {
+                      noAction = false;
+                      const bool standalone = request->getParam("standalone")->value() == "true";
+                      if (standalone != config.standalone)
+                      {
+                          config.standalone = standalone;
+                          saveConfig();
+                          // the backend is expected from now on, or not any more
+                          if (standalone)
+                              releaseSource(SOURCE_BACKEND);
+                          else
+                              setSourceState(SOURCE_BACKEND, TALLY_OFF, backendLease);
+                      }
+                  }
 
                   if (request->hasParam("brightness"))
                   {
@@ -335,12 +2395,7 @@ void setup()
                       int brightness = brightnessParam.toInt();
                       if (brightness >= 0 && brightness <= 255)
                       {
-                          const uint8_t newBrightness = static_cast<uint8_t>(brightness);
-                          if (newBrightness != config.brightness)
-                          {
-                              config.brightness = static_cast<uint8_t>(brightness);
-                              saveConfig();
-                          }
+                          setBrightness(static_cast<uint8_t>(brightness));
                       }
                       else
                       {
@@ -348,6 +2403,45 @@ void setup()
                       }
                   }
 
+                  if (request->hasParam("dmxMode"))
+                  {
+                      noAction = false;
+                      auto mode = dmxModeFromString(request->getParam("dmxMode")->value());
+                      if (!mode)
+                      {
+                          SEND_ERROR("Invalid dmxMode value");
+                      }
+                      config.dmxMode = mode.value();
+                  }
+
+                  if (request->hasParam("dmxUniverse"))
+                  {
+                      noAction = false;
+                      int universe = request->getParam("dmxUniverse")->value().toInt();
+                      if (universe < 1 || universe > 63999)
+                      {
+                          SEND_ERROR("Invalid dmxUniverse value");
+                      }
+                      config.dmxUniverse = static_cast<uint16_t>(universe);
+                  }
+
+                  if (request->hasParam("dmxAddress"))
+                  {
+                      noAction = false;
+                      int address = request->getParam("dmxAddress")->value().toInt();
+                      if (address < 1 || address > 512)
+                      {
+                          SEND_ERROR("Invalid dmxAddress value");
+                      }
+                      config.dmxAddress = static_cast<uint16_t>(address);
+                  }
+
+                  if (request->hasParam("dmxMode") || request->hasParam("dmxUniverse") || request->hasParam("dmxAddress"))
+                  {
+                      saveConfig();
+                      dmxListenPending = true; // sockets are reopened from loop()
+                  }
+
                   if (noAction)
                   {
                       SEND_ERROR("No parameters given");
@@ -359,29 +2453,36 @@ void setup()
                   request->send(200, "application/json", responseDoc.as<String>());
 
 #undef SEND_ERROR
-              });
+              })
+        .addMiddleware(&requestLimiter);
+
+    server.on("/capabilities", HTTP_GET, [](AsyncWebServerRequest *request)
+              { request->send(200, "application/json", capabilities.data); })
+        .addMiddleware(&requestLimiter);
 
     server.on("/ping", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-                  lastPing = millis();
-                  request->send(200, "text/plain", "pong"); });
+                  renewSourceLease(SOURCE_BACKEND, backendLease);
+                  request->send(200, "text/plain", "pong"); })
+        .addMiddleware(&requestLimiter);
 
     server.on("/identify", HTTP_GET, [](AsyncWebServerRequest *request)
               {
                   // validate api key
-                  if (!request->hasParam("apiKey") || request->getParam("apiKey")->value() != API_KEY)
+                  if (!checkApiKey(request))
                   {
                       request->send(403, "application/json", "{\"error\":\"Invalid API key\", \"success\": false}");
                       return;
                   }
 
-                  identifyStart = millis() + 5000; // identify for 10 seconds
-                  request->send(200, "application/json", "{\"success\": true}"); });
+                  startIdentify(5000);
+                  request->send(200, "application/json", "{\"success\": true}"); })
+        .addMiddleware(&requestLimiter);
 
     server.on("/restart", HTTP_GET, [](AsyncWebServerRequest *request)
               {
                   // validate api key
-                  if (!request->hasParam("apiKey") || request->getParam("apiKey")->value() != API_KEY)
+                  if (!checkApiKey(request))
                   {
                       request->send(403, "application/json", "{\"error\":\"Invalid API key\", \"success\": false}");
                       return;
@@ -389,10 +2490,54 @@ void setup()
 
                   request->send(200, "application/json", "{\"success\": true, \"message\": \"Resetting...\"}");
                   delay(1000);
-                  ESP.restart(); });
+                  ESP.restart(); })
+        .addMiddleware(&requestLimiter);
+
+    AsyncCallbackJsonWebHandler *batchHandler = new AsyncCallbackJsonWebHandler("/batch", handleBatch);
+    batchHandler->setMethod(HTTP_POST);
+    batchHandler->addMiddleware(&requestLimiter);
+    server.addHandler(batchHandler);
+
+    udpFrameAuth.begin(API_KEY);
+    wsFrameAuth.begin(API_KEY);
+    frameWs.onEvent(onFrameWsEvent);
+    server.addHandler(&frameWs);
+
+    ledEvents.onConnect(onMirrorConnect);
+    server.addHandler(&ledEvents);
 
     server.begin();
 
+    if (frameUdp.listen(frameUdpPort))
+    {
+        frameUdp.onPacket(onFramePacket);
+    }
+    else
+    {
+        Serial.println("Failed to listen for command frames");
+    }
+
+    if (oscUdp.listen(oscPort))
+    {
+        oscUdp.onPacket(onOscPacket);
+    }
+    else
+    {
+        Serial.println("Failed to listen for OSC");
+    }
+
+    if (mqttEnabled)
+    {
+        mqttStateTopic = String("tallylight/") + WiFi.getHostname() + "/state";
+        mqttStatusTopic = String("tallylight/") + WiFi.getHostname() + "/status";
+
+        mqttNetworkClient.setTimeout(2);
+        mqtt.setServer(MQTT_BROKER, mqttPort);
+        mqtt.setSocketTimeout(2);
+        mqtt.setKeepAlive(15);
+        mqtt.setCallback(onMqttMessage);
+    }
+
     digitalWrite(builtinLed, LOW); // Turn off after setup
 
     fill_solid(leds, ledCount, color_off);
@@ -401,7 +2546,10 @@ void setup()
     // configure time client
     timeClient.begin();
 
-    timeClient.forceUpdate();
+    if (timeClient.forceUpdate())
+        captureNtpEpoch();
+
+    startRendering();
 }
 
 void loop()
@@ -413,6 +2561,11 @@ void loop()
         return;
     }
 
+    if (takeConfigSaveDue())
+    {
+        saveConfig();
+    }
+
     if (WiFi.status() == WL_CONNECTED && !hasTriedOta)
     {
         hasTriedOta = true;
@@ -423,9 +2576,11 @@ void loop()
                                otaInProgress = true;
                                Serial.println("OTA Update Start");    
                                lastOtaTime = millis();
+                               suspendRendering(); // the device restarts after the update, successful or not
 
                                 fill_rainbow(leds, ledCount, 0, 255 / ledCount);
-                                FastLED.show(); });
+                                FastLED.show();
+                                mirrorLeds(); });
         httpUpdate.onEnd([]()
                          {
                              otaInProgress = false;
@@ -456,6 +2611,7 @@ void loop()
                                     uint8_t percent = progress / (total / 100);
                                     fill_solid(leds, ledCount, CRGB(255 - (percent * 2.55), percent * 2.55, 0));
                                     FastLED.show();
+                                    mirrorLeds();
                                 } 
                         });
         httpUpdate.onError([](int err)
@@ -511,6 +2667,7 @@ void loop()
             /*void fill_gradient(T *targetArray, u16 startpos, CHSV startcolor,
                    u16 endpos, CHSV endcolor,
                    TGradientDirectionCode directionCode = SHORTEST_HUES)*/
+            suspendRendering();
             fill_gradient(leds, 0, color_wifi_not_connected[0], ledCount - 1, color_wifi_not_connected[1], SHORTEST_HUES);
             FastLED.setBrightness(255);
             FastLED.show();
@@ -523,61 +2680,27 @@ void loop()
     }
     else
     {
+        if (!lastWiFiConnected)
+        {
+            dmxListenPending = true; // rejoin the multicast group
+            resumeRendering();
+        }
         lastWiFiConnected = true;
     }
 
-    timeClient.update();
-
-    // if no ping received for more than 25 seconds, go to error state
-    if (lastPing != 0 && millis() - lastPing > 25000 && tallyState != TALLY_ERROR)
-    {
-        lastPing = 0; // prevent multiple state changes
-        Serial.println("No ping received for 25 seconds, going to error state");
-        tallyState = TALLY_ERROR;
-    }
-
-    if (identifyStart != 0 && millis() > identifyStart)
+    if (dmxListenPending)
     {
-        identifyStart = 0; // stop identifying
+        dmxListenPending = false;
+        dmxListen();
     }
 
-    if (identifyStart != 0)
-    {
-        // blink blue
-        fill_solid(leds, ledCount, millis() % 500 < 250 ? color_identify : color_off);
-        FastLED.setBrightness(255);
-        FastLED.show();
-        return;
-    }
+    if (timeClient.update())
+        captureNtpEpoch();
 
-    // display current tally state
-    switch (tallyState)
-    {
-    case TALLY_OFF:
-        fill_solid(leds, ledCount, color_off);
-        break;
-    case TALLY_STANDBY:
-        fill_solid(leds, ledCount, color_standby);
-        break;
-    case TALLY_PROGRAM:
-        fill_solid(leds, ledCount, color_program);
-        break;
-    case TALLY_PREVIEW:
-        fill_solid(leds, ledCount, color_preview);
-        break;
-    case TALLY_ERROR:
-        fill_solid(leds, ledCount, timeClient.getEpochTime() % 2 < 1 ? color_error : color_off);
-        break;
-    default:
-        fill_solid(leds, ledCount, color_off);
-        Serial.printf("Unknown tally state: %d\n", tallyState);
-        break;
-    }
+    mqttLoop();
 
-    if (config.brightness != FastLED.getBrightness())
-    {
-        FastLED.setBrightness(config.brightness);
-    }
+    frameWs.cleanupClients();
 
-    FastLED.show();
+    // if no ping received for more than 25 seconds, the backend slot goes to error state
+    expireSourceLeases();
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Send sACN (E1.31) or Art-Net DMX to a tally light and compare sent vs. received packets.
+
+Example:
+    ./tools/dmx_sender.py 192.168.1.50 --protocol sacn --universe 1 --rate 44 --duration 10
+
+The light has to be configured first, e.g.
+    curl "http://<ip>:81/set?apiKey=<key>&dmxMode=RGB&dmxUniverse=1&dmxAddress=1"
+"""
+import argparse
+import json
+import socket
+import struct
+import time
+import urllib.request
+import uuid
+
+ZONES = 3
+
+
+def sacn_packet(cid, universe, sequence, priority, slots):
+    slot_count = len(slots)
+    dmp = struct.pack('!HBBHHH', 0x7000 | (11 + slot_count), 0x02, 0xA1, 0, 1, slot_count + 1) + b'\x00' + slots
+    framing = struct.pack('!HI64sBHBBH', 0x7000 | (77 + len(dmp)), 0x02, b'tallylight dmx_sender', priority, 0,
+                          sequence, 0, universe) + dmp
+    root = struct.pack('!HH12sHI16s', 0x0010, 0, b'ASC-E1.17\x00\x00\x00', 0x7000 | (22 + len(framing)), 0x04,
+                       cid) + framing
+    return root
+
+
+def artnet_packet(universe, sequence, slots):
+    port_address = universe - 1
+    return b'Art-Net\x00' + struct.pack('<H', 0x5000) + struct.pack('!HBBBBH', 14, sequence, 0, port_address & 0xFF,
+                                                                    (port_address >> 8) & 0x7F, len(slots)) + slots
+
+
+def frame(index, address):
+    # chase one lit zone through the strip, everything else dark
+    slots = bytearray(512)
+    zone = index % ZONES
+    hue = (index * 7) % 3
+    offset = address - 1 + zone * 3
+    slots[offset + hue] = 255
+    return bytes(slots)
+
+
+def fetch_stats(host):
+    with urllib.request.urlopen(f'http://{host}:81/', timeout=3) as response:
+        return json.load(response)['dmx']
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('host')
+    parser.add_argument('--protocol', choices=['sacn', 'artnet'], default='sacn')
+    parser.add_argument('--universe', type=int, default=1)
+    parser.add_argument('--address', type=int, default=1)
+    parser.add_argument('--priority', type=int, default=100)
+    parser.add_argument('--rate', type=float, default=44, help='packets per second, 0 for as fast as possible')
+    parser.add_argument('--duration', type=float, default=10)
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    port = 5568 if args.protocol == 'sacn' else 6454
+    cid = uuid.uuid4().bytes
+
+    before = fetch_stats(args.host)
+
+    sent = 0
+    sequence = 1
+    start = time.perf_counter()
+    next_send = start
+    while time.perf_counter() - start < args.duration:
+        slots = frame(sent // 10, args.address)
+        if args.protocol == 'sacn':
+            packet = sacn_packet(cid, args.universe, sequence, args.priority, slots)
+        else:
+            packet = artnet_packet(args.universe, sequence, slots)
+        sock.sendto(packet, (args.host, port))
+        sent += 1
+        sequence = sequence % 255 + 1  # Art-Net reserves 0 for "no sequence"
+
+        if args.rate > 0:
+            next_send += 1 / args.rate
+            delay = next_send - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+    elapsed = time.perf_counter() - start
+
+    time.sleep(0.5)
+    after = fetch_stats(args.host)
+
+    received = after['packets'] - before['packets']
+    dropped = after['dropped'] - before['dropped']
+    print(f'sent      {sent} packets in {elapsed:.2f} s ({sent / elapsed:.1f}/s)')
+    print(f'received  {received} ({100 * received / sent:.1f} %), {dropped} dropped as out of order')
+
+
+if __name__ == '__main__':
+    main()
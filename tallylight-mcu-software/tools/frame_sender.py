@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Send authenticated command frames to a tally light over UDP and measure round trips and verify cost.
+
+Example:
+    ./tools/frame_sender.py 192.168.1.50 --api-key tallylight --count 1000
+
+Frames alternate the state between PROGRAM and PREVIEW. The light's NTP time has to be within 30 s of ours.
+"""
+import argparse
+import hashlib
+import hmac
+import json
+import socket
+import statistics
+import struct
+import time
+import urllib.request
+
+MAC_SIZE = 8
+FRAME_SET = 0x01
+FRAME_REPLY = 0x80
+STATUS = ['OK', 'REPLAYED', 'STALE', 'INVALID_PAYLOAD', 'UNKNOWN_COMMAND']
+
+
+def build_frame(key, command, nonce, payload):
+    data = b'TL' + struct.pack('>BBQB', 1, command, nonce, len(payload)) + payload
+    return data + hmac.new(key, data, hashlib.sha256).digest()[:MAC_SIZE]
+
+
+def parse_reply(key, data):
+    body, mac = data[:-MAC_SIZE], data[-MAC_SIZE:]
+    if not hmac.compare_digest(hmac.new(key, body, hashlib.sha256).digest()[:MAC_SIZE], mac):
+        raise ValueError('reply has an invalid MAC')
+    _, _, command, nonce, length = struct.unpack('>2sBBQB', body[:13])
+    status, state, brightness = body[13:16]
+    return command, nonce, status, state, brightness
+
+
+def fetch_stats(host):
+    with urllib.request.urlopen(f'http://{host}:81/', timeout=3) as response:
+        return json.load(response)['frames']
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('host')
+    parser.add_argument('--port', type=int, default=8001)
+    parser.add_argument('--api-key', default='tallylight')
+    parser.add_argument('--count', type=int, default=1000)
+    parser.add_argument('--brightness', type=int, default=128)
+    args = parser.parse_args()
+
+    key = args.api_key.encode()
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(1)
+
+    before = fetch_stats(args.host)
+
+    counter = 0
+    rtts = []
+    failures = {}
+    lost = 0
+    for i in range(args.count):
+        counter += 1
+        nonce = (int(time.time()) << 32) | counter
+        frame = build_frame(key, FRAME_SET, nonce, bytes([2 if i % 2 == 0 else 3, args.brightness]))
+
+        start = time.perf_counter()
+        sock.sendto(frame, (args.host, args.port))
+        try:
+            while True:
+                data, _ = sock.recvfrom(64)
+                command, reply_nonce, status, _, _ = parse_reply(key, data)
+                if command == FRAME_SET | FRAME_REPLY and reply_nonce == nonce:
+                    break
+        except socket.timeout:
+            lost += 1
+            continue
+        rtts.append((time.perf_counter() - start) * 1000)
+        if status != 0:
+            failures[STATUS[status]] = failures.get(STATUS[status], 0) + 1
+
+    after = fetch_stats(args.host)
+
+    print(f'sent      {args.count} frames, {lost} without reply, rejected: {failures or "none"}')
+    if rtts:
+        rtts.sort()
+        print(f'rtt       median {statistics.median(rtts):.2f} ms, p99 {rtts[int(len(rtts) * 0.99) - 1]:.2f} ms, '
+              f'max {rtts[-1]:.2f} ms')
+    print(f'device    {after["accepted"] - before["accepted"]} accepted, '
+          f'verify avg {after["verifyAvgUs"]} us, max {after["verifyMaxUs"]} us (since boot)')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Flood a tally light's web server and check that rendering keeps its cadence.
+
+Example:
+    ./tools/http_flood.py 192.168.1.50 --api-key tallylight --threads 16 --duration 10
+
+Runs an idle window and a flood window of the same length. For each window it compares the light's
+render lateness histogram (frame shown vs. timer deadline), missed frames and request rejection counters.
+"""
+import argparse
+import collections
+import http.client
+import json
+import threading
+import time
+
+
+def fetch_info(host):
+    # the flood is over by now, but our bucket may still be empty
+    for _ in range(10):
+        connection = http.client.HTTPConnection(host, 81, timeout=3)
+        connection.request('GET', '/')
+        response = connection.getresponse()
+        body = response.read()
+        if response.status == 200:
+            return json.loads(body)
+        time.sleep(1)
+    raise RuntimeError('light keeps rejecting requests')
+
+
+def histogram_delta(before, after):
+    return [(b['leUs'], a['count'] - b['count']) for b, a in zip(before['render']['lateness'], after['render']['lateness'])]
+
+
+def print_window(name, before, after):
+    delta = histogram_delta(before, after)
+    frames = sum(count for _, count in delta)
+    missed = after['render']['missedFrames'] - before['render']['missedFrames']
+    print(f'{name}: {frames} frames, {missed} missed')
+    for limit, count in delta:
+        share = 100 * count / frames if frames else 0
+        print(f'    <= {limit:>5} us  {count:>7}  {share:5.1f} %')
+    for key in ('rateLimited', 'overloaded'):
+        print(f'    {key:<12} {after["requests"][key] - before["requests"][key]}')
+
+
+def flood(host, path, deadline, results):
+    while time.monotonic() < deadline:
+        try:
+            connection = http.client.HTTPConnection(host, 81, timeout=3)
+            connection.request('GET', path)
+            response = connection.getresponse()
+            response.read()
+            results[response.status] += 1
+        except OSError:
+            results['error'] += 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('host')
+    parser.add_argument('--api-key', default='tallylight')
+    parser.add_argument('--path', default=None, help='defaults to /set?state=PROGRAM')
+    parser.add_argument('--threads', type=int, default=16)
+    parser.add_argument('--duration', type=float, default=10)
+    args = parser.parse_args()
+
+    path = args.path or f'/set?apiKey={args.api_key}&state=PROGRAM'
+
+    before = fetch_info(args.host)
+    time.sleep(args.duration)
+    idle = fetch_info(args.host)
+    print_window('idle', before, idle)
+
+    results = collections.Counter()
+    deadline = time.monotonic() + args.duration
+    threads = [threading.Thread(target=flood, args=(args.host, path, deadline, results)) for _ in range(args.threads)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    flooded = fetch_info(args.host)
+    print_window('flood', idle, flooded)
+    total = sum(results.values())
+    print(f'    sent {total} requests ({total / args.duration:.0f}/s): {dict(results)}')
+    print(f'max render lateness since boot: {flooded["render"]["maxLatenessUs"]} us')
+
+
+if __name__ == '__main__':
+    main()
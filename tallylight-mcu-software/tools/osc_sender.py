@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Send OSC messages to a tally light and compare sent vs. decoded messages.
+
+Example:
+    ./tools/osc_sender.py 192.168.1.50 --rate 0 --duration 5
+    ./tools/osc_sender.py 192.168.1.50 --bundle 8 --address '/tally/{state,identify}'
+
+By default this alternates /tally/state between PROGRAM and PREVIEW.
+"""
+import argparse
+import json
+import socket
+import struct
+import time
+import urllib.request
+
+
+def osc_string(value):
+    data = value.encode() + b'\x00'
+    return data + b'\x00' * (-len(data) % 4)
+
+
+def osc_message(address, *args):
+    tags = ','
+    payload = b''
+    for arg in args:
+        if isinstance(arg, int):
+            tags += 'i'
+            payload += struct.pack('>i', arg)
+        elif isinstance(arg, float):
+            tags += 'f'
+            payload += struct.pack('>f', arg)
+        else:
+            tags += 's'
+            payload += osc_string(arg)
+    return osc_string(address) + osc_string(tags) + payload
+
+
+def osc_bundle(messages):
+    data = osc_string('#bundle') + struct.pack('>Q', 1)  # time tag 1 = immediately
+    for message in messages:
+        data += struct.pack('>i', len(message)) + message
+    return data
+
+
+def fetch_stats(host):
+    with urllib.request.urlopen(f'http://{host}:81/', timeout=3) as response:
+        return json.load(response)['osc']
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('host')
+    parser.add_argument('--port', type=int, default=8000)
+    parser.add_argument('--address', default='/tally/state')
+    parser.add_argument('--bundle', type=int, default=0, help='messages per bundle, 0 to send plain messages')
+    parser.add_argument('--rate', type=float, default=100, help='packets per second, 0 for as fast as possible')
+    parser.add_argument('--duration', type=float, default=10)
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    states = ['PROGRAM', 'PREVIEW']
+
+    before = fetch_stats(args.host)
+
+    packets = 0
+    messages = 0
+    start = time.perf_counter()
+    next_send = start
+    while time.perf_counter() - start < args.duration:
+        if args.bundle > 0:
+            batch = [osc_message(args.address, states[(messages + i) % 2]) for i in range(args.bundle)]
+            sock.sendto(osc_bundle(batch), (args.host, args.port))
+            messages += len(batch)
+        else:
+            sock.sendto(osc_message(args.address, states[messages % 2]), (args.host, args.port))
+            messages += 1
+        packets += 1
+
+        if args.rate > 0:
+            next_send += 1 / args.rate
+            delay = next_send - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+    elapsed = time.perf_counter() - start
+
+    time.sleep(0.5)
+    after = fetch_stats(args.host)
+
+    received = after['packets'] - before['packets']
+    decoded = after['messages'] - before['messages']
+    errors = after['errors'] - before['errors']
+    print(f'sent      {packets} packets / {messages} messages in {elapsed:.2f} s ({messages / elapsed:.1f} msg/s)')
+    print(f'received  {received} packets ({100 * received / packets:.1f} %), {decoded} messages decoded, {errors} errors')
+    print(f'device    {decoded / elapsed:.1f} msg/s')
+
+    # leave the light in a defined state
+    sock.sendto(osc_message('/tally/state', 'OFF'), (args.host, args.port))
+
+
+if __name__ == '__main__':
+    main()